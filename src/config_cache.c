@@ -0,0 +1,306 @@
+/*!
+ * \file config_cache.c
+ * \brief Cache of get-config results of a session
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <nc_client.h>
+
+#include "netopeerguid.h"
+#include "config_cache.h"
+
+/** \brief Maximum number of entries of a session, the oldest ones are dropped */
+#define CONFIG_CACHE_MAX_ENTRIES 16
+
+struct config_cache {
+    pthread_mutex_t lock;           /**< protects the members below and the references of the entries */
+    struct config_entry *entries;   /**< the newest first */
+    unsigned int count;             /**< number of entries */
+    unsigned int ttl;               /**< lifetime of the entries in seconds */
+    uint64_t generation;            /**< incremented by every invalidation */
+};
+
+/** \brief Source of version tags, unique among all the sessions */
+static uint64_t config_version;
+static pthread_mutex_t config_version_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+config_entry_free(struct config_entry *entry)
+{
+    lyd_free_withsiblings(entry->data);
+    free(entry->filter);
+    free(entry);
+}
+
+/**
+ * \brief Release the reference of an entry, the lock must be held.
+ * \return Whether the entry is to be freed.
+ */
+static int
+config_entry_unref(struct config_entry *entry)
+{
+    return !--entry->refcount;
+}
+
+static int
+config_entry_match(struct config_entry *entry, int operation, NC_DATASTORE source, const char *filter, int strict)
+{
+    if ((entry->operation != operation) || (entry->source != source) || (entry->strict != strict)) {
+        return 0;
+    }
+    if (!entry->filter || !filter) {
+        return entry->filter == filter;
+    }
+    return !strcmp(entry->filter, filter);
+}
+
+/**
+ * \brief Unlink the entries following prev (or the first one), the lock must be held.
+ * \return The unlinked entry if it is to be freed, NULL otherwise.
+ */
+static struct config_entry *
+config_cache_unlink(struct config_cache *cache, struct config_entry *prev)
+{
+    struct config_entry *entry;
+
+    if (prev) {
+        entry = prev->next;
+        prev->next = entry->next;
+    } else {
+        entry = cache->entries;
+        cache->entries = entry->next;
+    }
+    entry->next = NULL;
+    --cache->count;
+    return config_entry_unref(entry) ? entry : NULL;
+}
+
+struct config_cache *
+config_cache_new(unsigned int ttl)
+{
+    struct config_cache *cache;
+
+    cache = calloc(1, sizeof *cache);
+    if (!cache) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        return NULL;
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->ttl = ttl;
+    return cache;
+}
+
+void
+config_cache_free(struct config_cache *cache)
+{
+    struct config_entry *entry;
+
+    if (!cache) {
+        return;
+    }
+    while ((entry = cache->entries)) {
+        cache->entries = entry->next;
+        config_entry_free(entry);
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+uint64_t
+config_cache_generation(struct config_cache *cache)
+{
+    uint64_t generation;
+
+    pthread_mutex_lock(&cache->lock);
+    generation = cache->generation;
+    pthread_mutex_unlock(&cache->lock);
+    return generation;
+}
+
+struct config_entry *
+config_cache_get(struct config_cache *cache, int operation, NC_DATASTORE source, const char *filter, int strict)
+{
+    struct config_entry *entry, *prev = NULL, *expired = NULL;
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&cache->lock);
+    for (entry = cache->entries; entry; prev = entry, entry = entry->next) {
+        if (config_entry_match(entry, operation, source, filter, strict)) {
+            break;
+        }
+    }
+    if (entry && (now - entry->fetched >= (time_t)cache->ttl)) {
+        /* possibly changed by someone else meanwhile */
+        expired = config_cache_unlink(cache, prev);
+        entry = NULL;
+    } else if (entry) {
+        ++entry->refcount;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (expired) {
+        config_entry_free(expired);
+    }
+    return entry;
+}
+
+struct config_entry *
+config_cache_find(struct config_cache *cache, const char *version)
+{
+    struct config_entry *entry, *prev = NULL, *expired = NULL;
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&cache->lock);
+    for (entry = cache->entries; entry; prev = entry, entry = entry->next) {
+        if (!strcmp(entry->version, version)) {
+            break;
+        }
+    }
+    if (entry && (now - entry->fetched >= (time_t)cache->ttl)) {
+        expired = config_cache_unlink(cache, prev);
+        entry = NULL;
+    } else if (entry) {
+        ++entry->refcount;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (expired) {
+        config_entry_free(expired);
+    }
+    return entry;
+}
+
+struct config_entry *
+config_cache_put(struct config_cache *cache, int operation, NC_DATASTORE source, const char *filter, int strict,
+                 struct lyd_node *data, uint64_t generation)
+{
+    struct config_entry *entry, *iter, *prev = NULL, *old = NULL, *dropped = NULL;
+
+    entry = calloc(1, sizeof *entry);
+    if (!entry || (filter && !(entry->filter = strdup(filter)))) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        free(entry);
+        lyd_free_withsiblings(data);
+        return NULL;
+    }
+    entry->operation = operation;
+    entry->source = source;
+    entry->strict = strict;
+    entry->data = data;
+    entry->fetched = time(NULL);
+    entry->refcount = 1;
+    entry->cache = cache;
+
+    pthread_mutex_lock(&config_version_lock);
+    ++config_version;
+    sprintf(entry->version, "%" PRIu64, config_version);
+    pthread_mutex_unlock(&config_version_lock);
+
+    pthread_mutex_lock(&cache->lock);
+    if (cache->ttl && (cache->generation == generation)) {
+        /* replace an older result of the same request */
+        for (iter = cache->entries; iter; prev = iter, iter = iter->next) {
+            if (config_entry_match(iter, operation, source, filter, strict)) {
+                old = config_cache_unlink(cache, prev);
+                break;
+            }
+        }
+        if (cache->count == CONFIG_CACHE_MAX_ENTRIES) {
+            for (prev = NULL, iter = cache->entries; iter->next; prev = iter, iter = iter->next);
+            dropped = config_cache_unlink(cache, prev);
+        }
+        ++entry->refcount;
+        entry->next = cache->entries;
+        cache->entries = entry;
+        ++cache->count;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (old) {
+        config_entry_free(old);
+    }
+    if (dropped) {
+        config_entry_free(dropped);
+    }
+    return entry;
+}
+
+void
+config_entry_put(struct config_entry *entry)
+{
+    int last;
+
+    pthread_mutex_lock(&entry->cache->lock);
+    last = config_entry_unref(entry);
+    pthread_mutex_unlock(&entry->cache->lock);
+
+    if (last) {
+        config_entry_free(entry);
+    }
+}
+
+void
+config_cache_invalidate(struct config_cache *cache)
+{
+    struct config_entry *entry, *next, *unused = NULL;
+
+    pthread_mutex_lock(&cache->lock);
+    ++cache->generation;
+    for (entry = cache->entries; entry; entry = next) {
+        next = entry->next;
+        entry->next = NULL;
+        if (config_entry_unref(entry)) {
+            entry->next = unused;
+            unused = entry;
+        }
+    }
+    cache->entries = NULL;
+    cache->count = 0;
+    pthread_mutex_unlock(&cache->lock);
+
+    for (entry = unused; entry; entry = next) {
+        next = entry->next;
+        config_entry_free(entry);
+    }
+}
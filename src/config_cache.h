@@ -0,0 +1,139 @@
+/*!
+ * \file config_cache.h
+ * \brief Cache of get-config results of a session
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#ifndef _CONFIG_CACHE_H
+#define _CONFIG_CACHE_H
+
+#include <stdint.h>
+#include <time.h>
+#include <libyang/libyang.h>
+#include <nc_client.h>
+
+/**
+ * \brief Cached result of a get-config (or of a get).
+ *
+ * Entries are reference counted, an entry replaced or invalidated while it is
+ * being used is freed with its last reference.
+ */
+struct config_entry {
+    int operation;                  /**< operation the data were retrieved by */
+    NC_DATASTORE source;            /**< datastore of get-config */
+    char *filter;                   /**< subtree filter, NULL for none */
+    int strict;                     /**< whether the data were parsed strictly */
+    struct lyd_node *data;          /**< received data, read-only */
+    char version[24];               /**< version tag of the data */
+    time_t fetched;                 /**< time the data were received */
+    unsigned int refcount;          /**< protected by the lock of the cache */
+    struct config_cache *cache;
+    struct config_entry *next;
+};
+
+/**
+ * \brief get-config results of a session indexed by the datastore and the filter.
+ *
+ * Results of get are cached too if a request needs them repeatedly (e.g. for
+ * their pages), they are indexed by the filter.
+ *
+ * The cache is invalidated whenever the session runs an operation that may
+ * change a datastore. Changes made by other clients are noticed only when an
+ * entry expires.
+ */
+struct config_cache;
+
+/**
+ * \brief Create an empty cache
+ * \param[in] ttl lifetime of the entries in seconds
+ * \return New cache, NULL on memory allocation failure.
+ */
+struct config_cache *config_cache_new(unsigned int ttl);
+
+/**
+ * \brief Free a cache, neither it nor any of its entries may be used anymore
+ */
+void config_cache_free(struct config_cache *cache);
+
+/**
+ * \brief Get the current generation of a cache, it changes with every invalidation
+ */
+uint64_t config_cache_generation(struct config_cache *cache);
+
+/**
+ * \brief Find a valid entry
+ * \return Referenced entry, NULL if there is none.
+ */
+struct config_entry *config_cache_get(struct config_cache *cache, int operation, NC_DATASTORE source, const char *filter,
+                                      int strict);
+
+/**
+ * \brief Find a valid entry by the version of its data
+ * \return Referenced entry, NULL if there is none.
+ */
+struct config_entry *config_cache_find(struct config_cache *cache, const char *version);
+
+/**
+ * \brief Store received data
+ *
+ * If the cache was invalidated since the generation, the data may be outdated
+ * and the returned entry is not stored.
+ *
+ * \param[in] cache cache
+ * \param[in] operation operation the data were retrieved by
+ * \param[in] source datastore of get-config
+ * \param[in] filter subtree filter, can be NULL
+ * \param[in] strict whether the data were parsed strictly
+ * \param[in] data received data, they are always taken over
+ * \param[in] generation generation of the cache before the data were requested
+ * \return Referenced entry, NULL on memory allocation failure (data are freed).
+ */
+struct config_entry *config_cache_put(struct config_cache *cache, int operation, NC_DATASTORE source, const char *filter,
+                                      int strict, struct lyd_node *data, uint64_t generation);
+
+/**
+ * \brief Release a reference of an entry
+ */
+void config_entry_put(struct config_entry *entry);
+
+/**
+ * \brief Drop all the entries of a cache
+ */
+void config_cache_invalidate(struct config_cache *cache);
+
+#endif
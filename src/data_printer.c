@@ -0,0 +1,847 @@
+/*!
+ * \file data_printer.c
+ * \brief JSON printer of data trees annotated with schema metadata
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <nc_client.h>
+
+#include "netopeerguid.h"
+#include "json_writer.h"
+#include "metadata_cache.h"
+#include "data_printer.h"
+
+#define DATA_PRINTER_NAME_SIZE 256
+#define DATA_PRINTER_MEMBERS 32
+
+/**
+ * \brief Whether the metadata of a subtree are printed.
+ */
+enum data_scope {
+    DATA_SCOPE_NONE,            /**< not in the subtree nor any descendant */
+    DATA_SCOPE_PARTIAL,         /**< only in some descendant subtrees */
+    DATA_SCOPE_ALL              /**< in the whole subtree */
+};
+
+struct data_printer {
+    struct json_writer *writer;
+    const struct data_print_opts *opts;
+    unsigned int level;             /**< number of the inner nodes the printed members are in */
+};
+
+/**
+ * \brief Instance of a list or a leaf-list being sorted.
+ */
+struct data_sort_item {
+    const struct lyd_node *node;
+    const struct lyd_node_leaf_list *value; /**< value to sort by, NULL if the instance has none */
+    unsigned int pos;                       /**< position among the instances, keeps the sorting stable */
+};
+
+/**
+ * \brief Data nodes printed as the members of one JSON object.
+ *
+ * A list or a leaf-list is represented by its first printed instance. Small
+ * sets are kept on the stack.
+ */
+struct data_members {
+    const struct lyd_node **nodes;
+    unsigned int count;
+    unsigned int size;
+    const struct lyd_node *local[DATA_PRINTER_MEMBERS];
+};
+
+static void data_print_siblings(struct data_printer *printer, const struct lyd_node *first,
+                                const struct lys_module *parent_module, enum data_scope scope);
+
+static void
+data_members_init(struct data_members *members)
+{
+    members->nodes = members->local;
+    members->count = 0;
+    members->size = DATA_PRINTER_MEMBERS;
+}
+
+static void
+data_members_clean(struct data_members *members)
+{
+    if (members->nodes != members->local) {
+        free(members->nodes);
+    }
+}
+
+static int
+data_members_add(struct data_members *members, const struct lyd_node *node)
+{
+    const struct lyd_node **nodes;
+
+    if (members->count == members->size) {
+        if (members->nodes == members->local) {
+            nodes = malloc(2 * members->size * sizeof *nodes);
+            if (nodes) {
+                memcpy(nodes, members->local, members->count * sizeof *nodes);
+            }
+        } else {
+            nodes = realloc(members->nodes, 2 * members->size * sizeof *nodes);
+        }
+        if (!nodes) {
+            ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+            return 1;
+        }
+        members->nodes = nodes;
+        members->size *= 2;
+    }
+    members->nodes[members->count++] = node;
+    return 0;
+}
+
+/**
+ * \brief Check whether an instance of the schema node was already printed.
+ */
+static int
+data_members_find(const struct data_members *members, const struct lys_node *schema)
+{
+    unsigned int i;
+
+    for (i = 0; i < members->count; ++i) {
+        if (members->nodes[i]->schema == schema) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * \brief Check whether a data node is printed, implicit configuration defaults are omitted.
+ */
+static int
+data_toprint(const struct lyd_node *node)
+{
+    return !(node->dflt && (node->schema->flags & LYS_CONFIG_W));
+}
+
+/**
+ * \brief Find out whether the metadata of a schema node are printed, i.e. it is in one of the requested subtrees.
+ */
+static enum data_scope
+data_scope(struct data_printer *printer, const struct lys_node *schema)
+{
+    enum data_scope scope = DATA_SCOPE_NONE;
+    const char *path, *req;
+    size_t len, req_len;
+    unsigned int i;
+
+    path = metadata_cache_path(printer->opts->cache, schema);
+    if (!path) {
+        return DATA_SCOPE_NONE;
+    }
+    len = strlen(path);
+
+    for (i = 0; i < printer->opts->path_count; ++i) {
+        req = printer->opts->paths[i];
+        req_len = strlen(req);
+        if ((req_len <= len) && !strncmp(path, req, req_len) && ((path[req_len] == '\0') || (path[req_len] == '/'))) {
+            /* the node is in the subtree */
+            return DATA_SCOPE_ALL;
+        }
+        if ((req_len > len) && !strncmp(path, req, len) && (req[len] == '/')) {
+            /* the subtree is under the node */
+            scope = DATA_SCOPE_PARTIAL;
+        }
+    }
+    return scope;
+}
+
+/**
+ * \brief Write a member name, qualified by its module if it differs from the module of the parent.
+ */
+static void
+data_print_key(struct json_writer *writer, const char *prefix, const struct lys_module *module,
+               const struct lys_module *parent_module, const char *name)
+{
+    char buf[DATA_PRINTER_NAME_SIZE], *key = buf;
+    const char *mod_name = (module == parent_module) ? "" : module->name;
+    const char *colon = (module == parent_module) ? "" : ":";
+    int len;
+
+    len = snprintf(buf, sizeof buf, "%s%s%s%s", prefix, mod_name, colon, name);
+    if (len >= (int)sizeof buf) {
+        key = malloc(len + 1);
+        if (!key) {
+            ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+            writer->error = 1;
+            return;
+        }
+        snprintf(key, len + 1, "%s%s%s%s", prefix, mod_name, colon, name);
+    }
+    json_writer_key(writer, key);
+    if (key != buf) {
+        free(key);
+    }
+}
+
+static void
+data_print_attrs(struct json_writer *writer, const struct lyd_attr *attr)
+{
+    json_writer_object_start(writer);
+    for (; attr; attr = attr->next) {
+        data_print_key(writer, "", lys_main_module(attr->annotation->module), NULL, attr->name);
+        json_writer_string(writer, attr->value_str ? attr->value_str : "");
+    }
+    json_writer_object_end(writer);
+}
+
+static void
+data_print_value(struct json_writer *writer, const struct lyd_node_leaf_list *leaf)
+{
+    const struct lyd_node_leaf_list *target = leaf;
+    const struct lys_module *module;
+    const char *value = leaf->value_str ? leaf->value_str : "";
+    const char *colon;
+
+    /* a leafref is encoded as the leaf it refers to */
+    while ((target->value_type == LY_TYPE_LEAFREF) && !(target->value_flags & LY_VALUE_UNRES)
+            && target->value.leafref) {
+        target = (const struct lyd_node_leaf_list *)target->value.leafref;
+    }
+
+    switch (target->value_type) {
+    case LY_TYPE_BOOL:
+    case LY_TYPE_INT8:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_UINT32:
+        if (value[0]) {
+            json_writer_raw(writer, value, strlen(value));
+        } else {
+            json_writer_raw(writer, "null", 4);
+        }
+        break;
+    case LY_TYPE_EMPTY:
+        json_writer_raw(writer, "[null]", 6);
+        break;
+    case LY_TYPE_IDENT:
+        /* identities of the leaf's own module are not prefixed */
+        module = lys_node_module(leaf->schema);
+        colon = strchr(value, ':');
+        if (colon && (strlen(module->name) == (size_t)(colon - value)) && !strncmp(value, module->name, colon - value)) {
+            value = colon + 1;
+        }
+        json_writer_string(writer, value);
+        break;
+    default:
+        /* strings, 64-bit and decimal numbers and values that are not resolved */
+        json_writer_string(writer, value);
+        break;
+    }
+}
+
+static void
+data_print_anydata(struct data_printer *printer, const struct lyd_node_anydata *any)
+{
+    struct json_writer *writer = printer->writer;
+    char *xml = NULL;
+
+    switch (any->value_type) {
+    case LYD_ANYDATA_CONSTSTRING:
+    case LYD_ANYDATA_STRING:
+    case LYD_ANYDATA_SXML:
+    case LYD_ANYDATA_SXMLD:
+        json_writer_string(writer, any->value.str ? any->value.str : "");
+        break;
+    case LYD_ANYDATA_JSON:
+    case LYD_ANYDATA_JSOND:
+        if (any->value.str && any->value.str[0]) {
+            json_writer_raw(writer, any->value.str, strlen(any->value.str));
+        } else {
+            json_writer_raw(writer, "[null]", 6);
+        }
+        break;
+    case LYD_ANYDATA_XML:
+        lyxml_print_mem(&xml, any->value.xml, LYXML_PRINT_SIBLINGS);
+        json_writer_string(writer, xml ? xml : "");
+        free(xml);
+        break;
+    case LYD_ANYDATA_DATATREE:
+        /* the content is not described by the schema of the session */
+        json_writer_object_start(writer);
+        data_print_siblings(printer, any->value.tree, NULL, DATA_SCOPE_NONE);
+        json_writer_object_end(writer);
+        break;
+    default:
+        json_writer_raw(writer, "[null]", 6);
+        break;
+    }
+}
+
+/**
+ * \brief Write the data path of a node, null for no node.
+ */
+static void
+data_print_path(struct json_writer *writer, const struct lyd_node *node)
+{
+    char *path;
+
+    if (!node) {
+        json_writer_raw(writer, "null", 4);
+        return;
+    }
+    path = lyd_path(node);
+    if (!path) {
+        ERROR("Getting the path of a data node failed.");
+        writer->error = 1;
+        return;
+    }
+    json_writer_string(writer, path);
+    free(path);
+}
+
+/**
+ * \brief Print the metadata of a schema node, or their key in the dictionary.
+ */
+static void
+data_print_metadata(struct data_printer *printer, const struct lys_node *schema)
+{
+    if (printer->opts->dict) {
+        metadata_dict_write_ref(printer->opts->dict, printer->opts->cache, printer->writer, schema, printer->opts->metadata);
+    } else {
+        metadata_cache_write(printer->opts->cache, printer->writer, schema, printer->opts->metadata);
+    }
+}
+
+/**
+ * \brief Print the members of a node cut by the depth limit, only the keys of a list instance and its path.
+ */
+static void
+data_print_collapsed(struct data_printer *printer, const struct lyd_node *node, const struct lys_module *module)
+{
+    const struct lys_node_list *list;
+    const struct lyd_node *child;
+    unsigned int i;
+
+    if (!node->child) {
+        /* nothing to expand */
+        return;
+    }
+
+    if (node->schema->nodetype == LYS_LIST) {
+        list = (const struct lys_node_list *)node->schema;
+        LY_TREE_FOR(node->child, child) {
+            for (i = 0; (i < list->keys_size) && (child->schema != (struct lys_node *)list->keys[i]); ++i);
+            if (i < list->keys_size) {
+                data_print_key(printer->writer, "", lys_node_module(child->schema), module, child->schema->name);
+                data_print_value(printer->writer, (const struct lyd_node_leaf_list *)child);
+            }
+        }
+    }
+
+    json_writer_key(printer->writer, "$collapsed");
+    data_print_path(printer->writer, node);
+}
+
+/**
+ * \brief Print a container, a list instance, an RPC or a notification as an object.
+ */
+static void
+data_print_inner(struct data_printer *printer, const struct lyd_node *node, const struct lys_module *module,
+                 enum data_scope scope)
+{
+    json_writer_object_start(printer->writer);
+    if (node->attr) {
+        json_writer_key(printer->writer, "@");
+        data_print_attrs(printer->writer, node->attr);
+    }
+    if (printer->opts->depth && (printer->level + 1 >= printer->opts->depth)) {
+        data_print_collapsed(printer, node, module);
+    } else {
+        ++printer->level;
+        data_print_siblings(printer, node->child, module, scope);
+        --printer->level;
+    }
+    json_writer_object_end(printer->writer);
+}
+
+/**
+ * \brief Find the page of a list or a leaf-list requested in the options.
+ */
+static const struct data_page *
+data_page_find(struct data_printer *printer, const struct lys_node *schema)
+{
+    const char *path;
+    unsigned int i;
+
+    if (!printer->opts->page_count) {
+        return NULL;
+    }
+    path = metadata_cache_path(printer->opts->cache, schema);
+    if (!path) {
+        return NULL;
+    }
+    for (i = 0; i < printer->opts->page_count; ++i) {
+        if (!strcmp(printer->opts->pages[i].path, path)) {
+            return &printer->opts->pages[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * \brief Get the value to sort an instance by, the instance itself for a leaf-list or its child leaf for a list.
+ */
+static const struct lyd_node_leaf_list *
+data_sort_value(const struct lyd_node *node, const char *name)
+{
+    const struct lyd_node *child;
+
+    if (node->schema->nodetype == LYS_LEAFLIST) {
+        return (const struct lyd_node_leaf_list *)node;
+    }
+    LY_TREE_FOR(node->child, child) {
+        if ((child->schema->nodetype == LYS_LEAF) && !strcmp(child->schema->name, name)) {
+            return (const struct lyd_node_leaf_list *)child;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * \brief Compare two values, numbers by their value and anything else as strings.
+ */
+static int
+data_value_cmp(const struct lyd_node_leaf_list *a, const struct lyd_node_leaf_list *b)
+{
+    const char *str_a = a->value_str ? a->value_str : "", *str_b = b->value_str ? b->value_str : "";
+    long long int int_a, int_b;
+    unsigned long long int uint_a, uint_b;
+    double dec_a, dec_b;
+
+    if (a->value_type == b->value_type) {
+        switch (a->value_type) {
+        case LY_TYPE_INT8:
+        case LY_TYPE_INT16:
+        case LY_TYPE_INT32:
+        case LY_TYPE_INT64:
+            int_a = strtoll(str_a, NULL, 10);
+            int_b = strtoll(str_b, NULL, 10);
+            return (int_a > int_b) - (int_a < int_b);
+        case LY_TYPE_UINT8:
+        case LY_TYPE_UINT16:
+        case LY_TYPE_UINT32:
+        case LY_TYPE_UINT64:
+            uint_a = strtoull(str_a, NULL, 10);
+            uint_b = strtoull(str_b, NULL, 10);
+            return (uint_a > uint_b) - (uint_a < uint_b);
+        case LY_TYPE_DEC64:
+            dec_a = strtod(str_a, NULL);
+            dec_b = strtod(str_b, NULL);
+            return (dec_a > dec_b) - (dec_a < dec_b);
+        default:
+            break;
+        }
+    }
+    return strcmp(str_a, str_b);
+}
+
+static int
+data_sort_cmp(const void *item_a, const void *item_b, void *descending)
+{
+    const struct data_sort_item *a = item_a, *b = item_b;
+    int ret;
+
+    if (a->value && b->value) {
+        ret = data_value_cmp(a->value, b->value);
+        if (*(const int *)descending) {
+            ret = -ret;
+        }
+    } else {
+        /* instances without the value go last */
+        ret = !a->value - !b->value;
+    }
+    if (!ret) {
+        ret = (a->pos > b->pos) - (a->pos < b->pos);
+    }
+    return ret;
+}
+
+/**
+ * \brief Print a page of the instances of a list or a leaf-list among the siblings as an array.
+ *
+ * The instances are collected (and sorted) first, so the page is printed as if
+ * there were no other instances, followed by the number of all of them.
+ */
+static void
+data_print_page(struct data_printer *printer, const struct lyd_node *node, const struct lys_module *module,
+                const struct lys_module *parent_module, enum data_scope scope, const struct data_page *page)
+{
+    struct json_writer *writer = printer->writer;
+    struct data_sort_item *items = NULL, *tmp;
+    const struct lyd_node *iter;
+    unsigned int count = 0, size = 0, i, first, last;
+    int attrs = 0;
+
+    for (iter = node; iter; iter = iter->next) {
+        if ((iter->schema != node->schema) || !data_toprint(iter)) {
+            continue;
+        }
+        if (count == size) {
+            size = size ? 2 * size : DATA_PRINTER_MEMBERS;
+            tmp = realloc(items, size * sizeof *items);
+            if (!tmp) {
+                ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+                writer->error = 1;
+                free(items);
+                return;
+            }
+            items = tmp;
+        }
+        items[count].node = iter;
+        items[count].value = page->sort ? data_sort_value(iter, page->sort) : NULL;
+        items[count].pos = count;
+        ++count;
+    }
+
+    if (page->sort) {
+        qsort_r(items, count, sizeof *items, data_sort_cmp, (void *)&page->descending);
+    }
+    first = (page->offset < count) ? page->offset : count;
+    last = (page->limit && (page->limit < count - first)) ? first + page->limit : count;
+
+    json_writer_array_start(writer);
+    for (i = first; i < last; ++i) {
+        if (node->schema->nodetype == LYS_LIST) {
+            data_print_inner(printer, items[i].node, module, scope);
+        } else {
+            data_print_value(writer, (const struct lyd_node_leaf_list *)items[i].node);
+            attrs |= (items[i].node->attr != NULL);
+        }
+    }
+    json_writer_array_end(writer);
+
+    if (attrs) {
+        data_print_key(writer, "@", module, parent_module, node->schema->name);
+        json_writer_array_start(writer);
+        for (i = first; i < last; ++i) {
+            if (items[i].node->attr) {
+                data_print_attrs(writer, items[i].node->attr);
+            } else {
+                json_writer_raw(writer, "null", 4);
+            }
+        }
+        json_writer_array_end(writer);
+    }
+
+    data_print_key(writer, "$#", module, parent_module, node->schema->name);
+    json_writer_int(writer, count);
+
+    free(items);
+}
+
+/**
+ * \brief Print all the instances of a list or a leaf-list among the siblings as an array.
+ */
+static void
+data_print_instances(struct data_printer *printer, const struct lyd_node *node, const struct lys_module *module,
+                     const struct lys_module *parent_module, enum data_scope scope)
+{
+    struct json_writer *writer = printer->writer;
+    const struct data_page *page;
+    const struct lyd_node *iter;
+    int attrs = 0;
+
+    page = data_page_find(printer, node->schema);
+    if (page) {
+        data_print_page(printer, node, module, parent_module, scope, page);
+        return;
+    }
+
+    json_writer_array_start(writer);
+    for (iter = node; iter; iter = iter->next) {
+        if ((iter->schema != node->schema) || !data_toprint(iter)) {
+            continue;
+        }
+        if (node->schema->nodetype == LYS_LIST) {
+            data_print_inner(printer, iter, module, scope);
+        } else {
+            data_print_value(writer, (const struct lyd_node_leaf_list *)iter);
+            attrs |= (iter->attr != NULL);
+        }
+    }
+    json_writer_array_end(writer);
+
+    if (!attrs) {
+        return;
+    }
+
+    /* leaf-list attributes, by the position of the instance */
+    data_print_key(writer, "@", module, parent_module, node->schema->name);
+    json_writer_array_start(writer);
+    for (iter = node; iter; iter = iter->next) {
+        if ((iter->schema != node->schema) || !data_toprint(iter)) {
+            continue;
+        }
+        if (iter->attr) {
+            data_print_attrs(writer, iter->attr);
+        } else {
+            json_writer_raw(writer, "null", 4);
+        }
+    }
+    json_writer_array_end(writer);
+}
+
+/**
+ * \brief Print the members of an object for a set of sibling data nodes, followed by their metadata.
+ */
+static void
+data_print_siblings(struct data_printer *printer, const struct lyd_node *first, const struct lys_module *parent_module,
+                    enum data_scope scope)
+{
+    struct json_writer *writer = printer->writer;
+    struct data_members members, metadata;
+    const struct lyd_node *node;
+    const struct lys_module *module;
+    enum data_scope node_scope;
+    unsigned int i;
+
+    data_members_init(&members);
+    data_members_init(&metadata);
+
+    LY_TREE_FOR(first, node) {
+        if (!data_toprint(node)) {
+            continue;
+        }
+        if ((node->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) && data_members_find(&members, node->schema)) {
+            /* already printed with the first instance */
+            continue;
+        }
+        if (data_members_add(&members, node)) {
+            writer->error = 1;
+            break;
+        }
+
+        node_scope = (scope == DATA_SCOPE_PARTIAL) ? data_scope(printer, node->schema) : scope;
+        if ((node_scope == DATA_SCOPE_ALL) && data_members_add(&metadata, node)) {
+            writer->error = 1;
+            break;
+        }
+
+        module = lys_node_module(node->schema);
+        data_print_key(writer, "", module, parent_module, node->schema->name);
+
+        switch (node->schema->nodetype) {
+        case LYS_LIST:
+        case LYS_LEAFLIST:
+            data_print_instances(printer, node, module, parent_module, node_scope);
+            break;
+        case LYS_LEAF:
+            data_print_value(writer, (const struct lyd_node_leaf_list *)node);
+            if (node->attr) {
+                data_print_key(writer, "@", module, parent_module, node->schema->name);
+                data_print_attrs(writer, node->attr);
+            }
+            break;
+        case LYS_ANYXML:
+        case LYS_ANYDATA:
+            data_print_anydata(printer, (const struct lyd_node_anydata *)node);
+            break;
+        default:
+            data_print_inner(printer, node, module, node_scope);
+            break;
+        }
+    }
+
+    for (i = 0; i < metadata.count; ++i) {
+        node = metadata.nodes[i];
+        data_print_key(writer, "$@", lys_node_module(node->schema), parent_module, node->schema->name);
+        data_print_metadata(printer, node->schema);
+    }
+
+    data_members_clean(&members);
+    data_members_clean(&metadata);
+}
+
+/**
+ * \brief Get the scope of the metadata of the top-level data.
+ */
+static enum data_scope
+data_print_init(struct data_printer *printer, struct json_writer *writer, const struct data_print_opts *opts)
+{
+    printer->writer = writer;
+    printer->opts = opts;
+    printer->level = 0;
+    if (opts->metadata == METADATA_NONE) {
+        return DATA_SCOPE_NONE;
+    } else if (opts->paths) {
+        return DATA_SCOPE_PARTIAL;
+    }
+    return DATA_SCOPE_ALL;
+}
+
+void
+data_print(struct json_writer *writer, const struct lyd_node *data, const struct data_print_opts *opts)
+{
+    struct data_printer printer;
+    enum data_scope scope;
+
+    scope = data_print_init(&printer, writer, opts);
+
+    json_writer_object_start(writer);
+    data_print_siblings(&printer, data, NULL, scope);
+    json_writer_object_end(writer);
+}
+
+void
+data_print_subtree(struct json_writer *writer, const struct lyd_node *node, const struct data_print_opts *opts)
+{
+    struct data_printer printer;
+    enum data_scope scope;
+
+    scope = data_print_init(&printer, writer, opts);
+    if (scope == DATA_SCOPE_PARTIAL) {
+        scope = data_scope(&printer, node->schema);
+    }
+
+    json_writer_object_start(writer);
+    data_print_siblings(&printer, node->child, lys_node_module(node->schema), scope);
+    json_writer_object_end(writer);
+}
+
+/**
+ * \brief Print a single change of the data as an object of the patch.
+ *
+ * \param[in] printer printer
+ * \param[in] op kind of the change
+ * \param[in] node changed node
+ * \param[in] value whether to print the (new) value of the node
+ * \param[in] moved whether the node was moved, after the preceding node
+ * \param[in] after node the changed node follows, NULL if it is the first one
+ * \param[in] scope scope of the metadata of the top-level data
+ */
+static void
+data_print_change(struct data_printer *printer, const char *op, const struct lyd_node *node, int value, int moved,
+                  const struct lyd_node *after, enum data_scope scope)
+{
+    struct json_writer *writer = printer->writer;
+
+    json_writer_object_start(writer);
+    json_writer_key(writer, "op");
+    json_writer_string(writer, op);
+    json_writer_key(writer, "path");
+    data_print_path(writer, node);
+    if (moved) {
+        json_writer_key(writer, "after");
+        data_print_path(writer, after);
+    }
+    if (value) {
+        if (scope == DATA_SCOPE_PARTIAL) {
+            scope = data_scope(printer, node->schema);
+        }
+        json_writer_key(writer, "value");
+        switch (node->schema->nodetype) {
+        case LYS_LEAF:
+        case LYS_LEAFLIST:
+            data_print_value(writer, (const struct lyd_node_leaf_list *)node);
+            break;
+        case LYS_ANYXML:
+        case LYS_ANYDATA:
+            data_print_anydata(printer, (const struct lyd_node_anydata *)node);
+            break;
+        default:
+            data_print_inner(printer, node, lys_node_module(node->schema), scope);
+            break;
+        }
+        if (scope == DATA_SCOPE_ALL) {
+            json_writer_key(writer, "metadata");
+            data_print_metadata(printer, node->schema);
+        }
+    }
+    json_writer_object_end(writer);
+}
+
+void
+data_print_diff(struct json_writer *writer, const struct lyd_node *old, const struct lyd_node *new,
+                const struct data_print_opts *opts)
+{
+    struct data_printer printer;
+    struct lyd_difflist *diff;
+    enum data_scope scope;
+    unsigned int i;
+
+    scope = data_print_init(&printer, writer, opts);
+
+    diff = lyd_diff((struct lyd_node *)old, (struct lyd_node *)new, 0);
+    if (!diff) {
+        ERROR("Comparing data with the snapshot failed.");
+        writer->error = 1;
+        return;
+    }
+
+    json_writer_array_start(writer);
+    for (i = 0; diff->type[i] != LYD_DIFF_END; ++i) {
+        switch (diff->type[i]) {
+        case LYD_DIFF_DELETED:
+            if (data_toprint(diff->first[i])) {
+                data_print_change(&printer, "delete", diff->first[i], 0, 0, NULL, scope);
+            }
+            break;
+        case LYD_DIFF_CHANGED:
+            data_print_change(&printer, "modify", diff->second[i], 1, 0, NULL, scope);
+            break;
+        case LYD_DIFF_CREATED:
+            if (data_toprint(diff->second[i])) {
+                data_print_change(&printer, "create", diff->second[i], 1, 0, NULL, scope);
+            }
+            break;
+        case LYD_DIFF_MOVEDAFTER1:
+        case LYD_DIFF_MOVEDAFTER2:
+            data_print_change(&printer, "move", diff->first[i], 0, 1, diff->second[i], scope);
+            break;
+        default:
+            break;
+        }
+    }
+    json_writer_array_end(writer);
+
+    lyd_free_diff(diff);
+}
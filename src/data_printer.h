@@ -0,0 +1,127 @@
+/*!
+ * \file data_printer.h
+ * \brief JSON printer of data trees annotated with schema metadata
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#ifndef _DATA_PRINTER_H
+#define _DATA_PRINTER_H
+
+#include <libyang/libyang.h>
+
+#include "json_writer.h"
+#include "metadata_cache.h"
+
+/**
+ * \brief Page of the instances of a list or a leaf-list to print.
+ */
+struct data_page {
+    char *path;                     /**< schema path of the list (e.g. "/ietf-interfaces:interfaces/interface") */
+    unsigned int offset;            /**< number of leading instances to skip */
+    unsigned int limit;             /**< maximum number of instances to print, 0 for all */
+    char *sort;                     /**< name of the child leaf of a list to sort the instances by, NULL for no sorting */
+    int descending;                 /**< whether to sort in the descending order */
+};
+
+/**
+ * \brief Options of printing a data tree.
+ */
+struct data_print_opts {
+    struct metadata_cache *cache;   /**< metadata cache of the context of the data */
+    struct metadata_dict *dict;     /**< dictionary to collect the metadata in, NULL to write them inline */
+    enum metadata_level metadata;   /**< metadata to add in the "$@" members */
+    char **paths;                   /**< schema paths of the subtrees to add metadata to, NULL for all */
+    unsigned int path_count;        /**< number of paths */
+    struct data_page *pages;        /**< lists to print only a page of */
+    unsigned int page_count;        /**< number of pages */
+    unsigned int depth;             /**< number of levels of inner nodes to print, 0 for all */
+};
+
+/**
+ * \brief Print a data tree as a JSON object annotated with schema metadata.
+ *
+ * The tree is walked once and written straight into the writer in the libyang
+ * JSON encoding. After the members of every set of siblings, "$@<name>" members
+ * with the metadata of their schema nodes are added (once for all the instances
+ * of a list or a leaf-list). With a dictionary, the "$@<name>" members only hold
+ * the keys of the metadata in the dictionary.
+ *
+ * Of a list or a leaf-list with a page in the options, only the instances of
+ * the page are printed and "$#<name>" with the number of all the instances is
+ * added.
+ *
+ * With a depth limit, containers and list instances at the last level are
+ * printed collapsed, with only the keys of a list instance and "$collapsed"
+ * holding the data path of the node.
+ *
+ * \param[in] writer writer to write the object to
+ * \param[in] data first top-level data node, all its siblings are printed, can be NULL
+ * \param[in] opts printing options
+ */
+void data_print(struct json_writer *writer, const struct lyd_node *data, const struct data_print_opts *opts);
+
+/**
+ * \brief Print the children of a data node as a JSON object.
+ *
+ * The object is what data_print() prints as the value of the node (without its
+ * attributes), the depth limit counts from the node.
+ *
+ * \param[in] writer writer to write the object to
+ * \param[in] node container or list instance
+ * \param[in] opts printing options
+ */
+void data_print_subtree(struct json_writer *writer, const struct lyd_node *node, const struct data_print_opts *opts);
+
+/**
+ * \brief Print the changes between two data trees as a JSON array (a patch).
+ *
+ * Every change is an object with "op" (create, delete, modify or move) and the
+ * data "path" of the node. Created and modified nodes have their new "value"
+ * printed the same way as by data_print() and, if requested, the "metadata"
+ * of their schema node. Moved nodes of user-ordered lists have the path of the
+ * node they follow "after" (null for the first position).
+ *
+ * \param[in] writer writer to write the array to
+ * \param[in] old first top-level node of the former data, can be NULL
+ * \param[in] new first top-level node of the current data, can be NULL
+ * \param[in] opts printing options
+ */
+void data_print_diff(struct json_writer *writer, const struct lyd_node *old, const struct lyd_node *new,
+                     const struct data_print_opts *opts);
+
+#endif
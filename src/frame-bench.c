@@ -0,0 +1,274 @@
+/*!
+ * \file frame-bench.c
+ * \brief Benchmark of the frontend chunked framing reader
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+/*
+ * Compares recv() calls and throughput of the buffered frame reader with the
+ * byte-at-a-time reader it replaced. Both read the same chunked stream written
+ * into a socketpair by another thread. Link with -Wl,--wrap=recv so the calls
+ * are counted.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <err.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <nc_client.h>
+
+#include "netopeerguid.h"
+#include "frame_reader.h"
+
+int daemonize = 0;
+
+static unsigned long long recv_calls;
+
+ssize_t __real_recv(int fd, void *buf, size_t len, int flags);
+
+ssize_t
+__wrap_recv(int fd, void *buf, size_t len, int flags)
+{
+    ++recv_calls;
+    return __real_recv(fd, buf, len, flags);
+}
+
+struct stream {
+    int fd;
+    const char *msg;
+    size_t msg_len;
+    size_t chunk_size;
+    unsigned int count;
+};
+
+static void
+write_all(int fd, const char *data, size_t len)
+{
+    ssize_t ret;
+
+    while (len) {
+        ret = write(fd, data, len);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            err(1, "write");
+        }
+        data += ret;
+        len -= ret;
+    }
+}
+
+/* frontend sending the messages in chunks of chunk_size */
+static void *
+writer(void *arg)
+{
+    struct stream *stream = arg;
+    char header[32];
+    size_t off, len;
+    unsigned int i;
+
+    for (i = 0; i < stream->count; ++i) {
+        for (off = 0; off < stream->msg_len; off += len) {
+            len = stream->msg_len - off;
+            if (len > stream->chunk_size) {
+                len = stream->chunk_size;
+            }
+            write_all(stream->fd, header, sprintf(header, "\n#%zu\n", len));
+            write_all(stream->fd, stream->msg + off, len);
+        }
+        write_all(stream->fd, "\n##\n", 4);
+    }
+    return NULL;
+}
+
+/* the reader replaced by struct frame_reader, chunk data are read with MSG_WAITALL so it survives short reads */
+static char *
+bytewise_read(int client)
+{
+    size_t buffer_len = 0;
+    char *buffer = NULL;
+    char c, chunk_len_str[12];
+    int i, chunk_len;
+
+    while (1) {
+        if ((recv(client, &c, 1, 0) != 1) || (c != '\n')) {
+            break;
+        }
+        if ((recv(client, &c, 1, 0) != 1) || (c != '#')) {
+            break;
+        }
+        i = 0;
+        while ((recv(client, &c, 1, 0) == 1) && (isdigit((unsigned char)c) || (c == '#'))) {
+            if (!i && (c == '#')) {
+                if ((recv(client, &c, 1, 0) != 1) || (c != '\n')) {
+                    break;
+                }
+                return buffer;
+            }
+            chunk_len_str[i++] = c;
+            if (i == 11) {
+                break;
+            }
+        }
+        if (c != '\n') {
+            break;
+        }
+        chunk_len_str[i] = '\0';
+        if ((chunk_len = atoi(chunk_len_str)) == 0) {
+            break;
+        }
+        buffer = realloc(buffer, buffer_len + chunk_len + 1);
+        memset(buffer + buffer_len, 0, chunk_len + 1);
+        if (recv(client, buffer + buffer_len, chunk_len, MSG_WAITALL) != chunk_len) {
+            break;
+        }
+        buffer_len += chunk_len;
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+run(const char *name, int buffered, struct stream *stream)
+{
+    struct frame_reader reader;
+    json_object *request;
+    const char *error;
+    pthread_t thread;
+    int fds[2];
+    unsigned int i;
+    char *msg;
+    double start, secs, mb;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+        err(1, "socketpair");
+    }
+    stream->fd = fds[0];
+    if (buffered && frame_reader_init(&reader, fds[1])) {
+        errx(1, "frame_reader_init failed");
+    }
+
+    recv_calls = 0;
+    start = now();
+    if (pthread_create(&thread, NULL, writer, stream)) {
+        errx(1, "pthread_create failed");
+    }
+    for (i = 0; i < stream->count; ++i) {
+        if (buffered) {
+            if (frame_reader_read(&reader) != 1) {
+                errx(1, "%s: reading message %u failed", name, i);
+            }
+            request = frame_reader_take(&reader, &error);
+        } else {
+            if (!(msg = bytewise_read(fds[1]))) {
+                errx(1, "%s: reading message %u failed", name, i);
+            }
+            request = json_tokener_parse(msg);
+            free(msg);
+        }
+        if (!request) {
+            errx(1, "%s: message %u is not a valid request", name, i);
+        }
+        json_object_put(request);
+    }
+    secs = now() - start;
+    pthread_join(thread, NULL);
+
+    if (buffered) {
+        frame_reader_clean(&reader);
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    mb = (double)stream->msg_len * stream->count / (1024 * 1024);
+    printf("%-10s %12llu recv() %12.1f recv()/MB %10.3f s %10.1f MB/s\n", name, recv_calls, recv_calls / mb, secs,
+           mb / secs);
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct stream stream;
+    size_t size;
+    char *msg;
+    int len;
+
+    if (argc > 4) {
+        fprintf(stderr, "Usage: %s [message-KiB [messages [chunk-size]]]\n", argv[0]);
+        return 2;
+    }
+    size = (argc > 1) ? strtoul(argv[1], NULL, 10) * 1024 : 1024 * 1024;
+    stream.count = (argc > 2) ? strtoul(argv[2], NULL, 10) : 64;
+    stream.chunk_size = (argc > 3) ? strtoul(argv[3], NULL, 10) : 4096;
+    if ((size < 64) || !stream.count || !stream.chunk_size) {
+        errx(2, "invalid parameters");
+    }
+
+    /* get request with a large filter */
+    msg = malloc(size + 1);
+    len = sprintf(msg, "{\"type\": 6, \"session\": 1, \"strict\": false, \"filter\": \"");
+    memset(msg + len, 'x', size - len - 2);
+    strcpy(msg + size - 2, "\"}");
+    stream.msg = msg;
+    stream.msg_len = size;
+
+    printf("%u messages of %zu bytes in chunks of %zu bytes\n", stream.count, size, stream.chunk_size);
+    run("bytewise", 0, &stream);
+    run("buffered", 1, &stream);
+
+    free(msg);
+    return 0;
+}
@@ -0,0 +1,279 @@
+/*!
+ * \file frame_reader.c
+ * \brief Reader of chunked framed messages from the frontends
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <nc_client.h>
+
+#include "netopeerguid.h"
+#include "frame_reader.h"
+
+#define FRAME_READ_SIZE (64 * 1024)  /**< size of a single read from the frontend socket */
+#define FRAME_MAX_CHUNK_SIZE 4294967295ULL  /**< maximal chunk-size allowed by RFC6242 */
+#define FRAME_MAX_REQUEST_SIZE (64 * 1024 * 1024)  /**< maximal size of a frontend request */
+
+void
+frame_reader_clean(struct frame_reader *reader)
+{
+    free(reader->rbuf);
+    reader->rbuf = NULL;
+    if (reader->tok) {
+        json_tokener_free(reader->tok);
+    }
+    json_object_put(reader->request);
+    reader->tok = NULL;
+    reader->request = NULL;
+}
+
+int
+frame_reader_init(struct frame_reader *reader, int fd)
+{
+    memset(reader, 0, sizeof *reader);
+    reader->fd = fd;
+    reader->state = FRAME_START;
+    reader->rbuf = malloc(FRAME_READ_SIZE);
+    reader->tok = json_tokener_new();
+    if (!reader->rbuf || !reader->tok) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        frame_reader_clean(reader);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * \brief Check that only whitespace follows the parsed request in the message.
+ */
+static int
+frame_reader_trailing(const char *data, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        if (!isspace((unsigned char)data[i])) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * \brief Feed chunk data into the JSON parser of the message.
+ *
+ * Once the message is found invalid, the rest of its data is only skipped.
+ */
+static void
+frame_reader_feed(struct frame_reader *reader, const char *data, size_t len)
+{
+    enum json_tokener_error jerr;
+    size_t end;
+
+    reader->msg_len += len;
+    if (reader->error) {
+        return;
+    }
+
+    if (reader->msg_len > FRAME_MAX_REQUEST_SIZE) {
+        reader->error = "Request too large.";
+    } else if (reader->request) {
+        if (frame_reader_trailing(data, len)) {
+            reader->error = "Unexpected data after the request.";
+        }
+    } else {
+        reader->request = json_tokener_parse_ex(reader->tok, data, len);
+        jerr = json_tokener_get_error(reader->tok);
+        if (reader->request) {
+            end = json_tokener_get_parse_end(reader->tok);
+            if (frame_reader_trailing(data + end, len - end)) {
+                reader->error = "Unexpected data after the request.";
+            }
+        } else if (jerr != json_tokener_continue) {
+            ERROR("JSON parsing error (%s)", json_tokener_error_desc(jerr));
+            reader->error = "Invalid JSON request.";
+        }
+    }
+
+    if (reader->error && reader->request) {
+        json_object_put(reader->request);
+        reader->request = NULL;
+    }
+}
+
+/**
+ * \brief Parse the data buffered in the reader.
+ *
+ * \return 1 when a complete message was received, 0 when more data are needed, -1 on a framing error.
+ */
+static int
+frame_reader_parse(struct frame_reader *reader)
+{
+    size_t len;
+    char c;
+
+    while (reader->rbuf_pos < reader->rbuf_len) {
+        if (reader->state == FRAME_DATA) {
+            /* parse as much chunk data as available at once */
+            len = reader->rbuf_len - reader->rbuf_pos;
+            if (len > reader->chunk_left) {
+                len = reader->chunk_left;
+            }
+            frame_reader_feed(reader, reader->rbuf + reader->rbuf_pos, len);
+            reader->rbuf_pos += len;
+            reader->chunk_left -= len;
+            if (!reader->chunk_left) {
+                reader->state = FRAME_HDR_LF;
+            }
+            continue;
+        }
+
+        c = reader->rbuf[reader->rbuf_pos++];
+        switch (reader->state) {
+        case FRAME_START:
+            if (c == '\0') {
+                /* some clients send the terminating zero after the end-of-chunks */
+                break;
+            }
+            /* fallthrough */
+        case FRAME_HDR_LF:
+            if (c != '\n') {
+                return -1;
+            }
+            reader->state = FRAME_HDR_HASH;
+            break;
+        case FRAME_HDR_HASH:
+            if (c != '#') {
+                return -1;
+            }
+            reader->state = FRAME_HDR_SIZE;
+            break;
+        case FRAME_HDR_SIZE:
+            if ((c == '#') && reader->msg_len) {
+                /* end-of-chunks, but only after at least one chunk */
+                reader->state = FRAME_EOM_LF;
+            } else if ((c >= '1') && (c <= '9')) {
+                reader->chunk_left = c - '0';
+                reader->state = FRAME_HDR_DIGITS;
+            } else {
+                return -1;
+            }
+            break;
+        case FRAME_HDR_DIGITS:
+            if (c == '\n') {
+                reader->state = FRAME_DATA;
+            } else if (isdigit((unsigned char)c)) {
+                reader->chunk_left = reader->chunk_left * 10 + (c - '0');
+                if (reader->chunk_left > FRAME_MAX_CHUNK_SIZE) {
+                    ERROR("Chunk size exceeds the maximum allowed by RFC6242.");
+                    return -1;
+                }
+            } else {
+                return -1;
+            }
+            break;
+        case FRAME_EOM_LF:
+            if (c != '\n') {
+                return -1;
+            }
+            reader->state = FRAME_START;
+            if (!reader->request && !reader->error) {
+                reader->error = "Incomplete JSON request.";
+            }
+            return 1;
+        case FRAME_DATA:
+            /* handled above */
+            break;
+        }
+    }
+
+    return 0;
+}
+
+int
+frame_reader_read(struct frame_reader *reader)
+{
+    ssize_t ret;
+    int r;
+
+    while (1) {
+        r = frame_reader_parse(reader);
+        if (r) {
+            if (r == -1) {
+                ERROR("Invalid chunked framing received from a frontend.");
+            }
+            return r;
+        }
+
+        ret = recv(reader->fd, reader->rbuf, FRAME_READ_SIZE, 0);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return 0;
+            }
+            ERROR("Receiving frontend message failed (%s).", strerror(errno));
+            return -1;
+        } else if (ret == 0) {
+            /* EOF */
+            reader->eof = 1;
+            return -1;
+        }
+        reader->rbuf_pos = 0;
+        reader->rbuf_len = ret;
+    }
+}
+
+json_object *
+frame_reader_take(struct frame_reader *reader, const char **error)
+{
+    json_object *request = reader->request;
+
+    *error = reader->error;
+    reader->request = NULL;
+    reader->error = NULL;
+    reader->msg_len = 0;
+    json_tokener_reset(reader->tok);
+    return request;
+}
@@ -0,0 +1,120 @@
+/*!
+ * \file frame_reader.h
+ * \brief Reader of chunked framed messages from the frontends
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#ifndef _FRAME_READER_H
+#define _FRAME_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <json.h>
+
+/**
+ * \brief States of the RFC6242 chunked framing parser.
+ */
+enum frame_state {
+    FRAME_START,       /**< expecting '\n' starting the first chunk of a message */
+    FRAME_HDR_LF,      /**< expecting '\n' starting another chunk or end-of-chunks */
+    FRAME_HDR_HASH,    /**< expecting '#' */
+    FRAME_HDR_SIZE,    /**< expecting the first digit of chunk-size or the second '#' */
+    FRAME_HDR_DIGITS,  /**< reading chunk-size digits terminated by '\n' */
+    FRAME_EOM_LF,      /**< "##" was read, expecting the final '\n' */
+    FRAME_DATA         /**< copying chunk data */
+};
+
+/**
+ * \brief Per-connection reader of chunked framed messages.
+ *
+ * Socket data are read in large blocks into rbuf and chunk headers are parsed
+ * from memory, so a message costs a few recv() calls instead of one per byte.
+ * Chunk data are fed straight into the JSON parser, the message itself is never
+ * stored.
+ */
+struct frame_reader {
+    int fd;                 /**< connection socket */
+    char *rbuf;             /**< raw data read from the socket */
+    size_t rbuf_pos;        /**< first unprocessed byte in rbuf */
+    size_t rbuf_len;        /**< number of valid bytes in rbuf */
+    enum frame_state state; /**< framing parser state */
+    uint64_t chunk_left;    /**< chunk-size being parsed or remaining chunk data */
+    struct json_tokener *tok; /**< parser of the message being received */
+    json_object *request;   /**< parsed request once its closing bracket is received */
+    size_t msg_len;         /**< length of the message data received so far */
+    const char *error;      /**< reason the message is rejected, NULL while it is valid */
+    char eof;               /**< the frontend closed its side of the connection */
+};
+
+/**
+ * \brief Initialize reader of framed messages on a frontend connection.
+ *
+ * \param[in] reader  reader to initialize
+ * \param[in] fd      connection socket
+ * \return 0 on success, -1 on memory allocation failure
+ */
+int frame_reader_init(struct frame_reader *reader, int fd);
+
+/**
+ * \brief Free all the memory held by a reader, the socket is not closed.
+ */
+void frame_reader_clean(struct frame_reader *reader);
+
+/**
+ * \brief Read data from the connection until a complete framed message is reassembled.
+ *
+ * Data following the message in the same socket read are kept in the reader
+ * for the next call. On a non-blocking socket the function returns as soon as
+ * there are no more data to read.
+ *
+ * \param[in] reader  reader of the connection
+ * \return 1 when a message is complete (see frame_reader_take()), 0 when the
+ * socket would block, -1 on EOF (eof is set) or error (connection should be closed).
+ */
+int frame_reader_read(struct frame_reader *reader);
+
+/**
+ * \brief Take the parsed request out of the reader.
+ *
+ * \param[in] reader  reader of the connection
+ * \param[out] error  reason the message was rejected, NULL if the request is valid
+ * \return parsed request, caller is supposed to free it, NULL if the message was rejected.
+ */
+json_object *frame_reader_take(struct frame_reader *reader, const char **error);
+
+#endif
@@ -0,0 +1,321 @@
+/*!
+ * \file json_writer.c
+ * \brief Append-only JSON writer
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <nc_client.h>
+
+#include "netopeerguid.h"
+#include "json_writer.h"
+
+#define JSON_WRITER_MIN_SIZE 256
+
+/**
+ * \brief Make room for at least len more bytes (and the terminating zero).
+ */
+static int
+json_writer_reserve(struct json_writer *writer, size_t len)
+{
+    size_t new_size;
+    char *new_buf;
+
+    if (writer->error) {
+        return -1;
+    }
+    if (writer->len + len + 1 <= writer->size) {
+        return 0;
+    }
+
+    new_size = (writer->size ? writer->size : JSON_WRITER_MIN_SIZE);
+    while (new_size < writer->len + len + 1) {
+        new_size *= 2;
+    }
+    new_buf = realloc(writer->buf, new_size);
+    if (!new_buf) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        writer->error = 1;
+        return -1;
+    }
+    writer->buf = new_buf;
+    writer->size = new_size;
+    return 0;
+}
+
+static void
+json_writer_append(struct json_writer *writer, const char *data, size_t len)
+{
+    if (json_writer_reserve(writer, len)) {
+        return;
+    }
+    memcpy(writer->buf + writer->len, data, len);
+    writer->len += len;
+}
+
+/**
+ * \brief Write the separator needed before a new value or key.
+ */
+static void
+json_writer_separate(struct json_writer *writer)
+{
+    if (writer->after_key) {
+        writer->after_key = 0;
+        return;
+    }
+    if (writer->depth) {
+        if (writer->first[writer->depth - 1]) {
+            writer->first[writer->depth - 1] = 0;
+        } else {
+            json_writer_append(writer, ", ", 2);
+        }
+    }
+}
+
+static void
+json_writer_open(struct json_writer *writer, char bracket)
+{
+    unsigned char *new_first;
+
+    json_writer_separate(writer);
+    if (writer->depth == writer->depth_size) {
+        new_first = realloc(writer->first, writer->depth_size + 16);
+        if (!new_first) {
+            ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+            writer->error = 1;
+            return;
+        }
+        writer->first = new_first;
+        writer->depth_size += 16;
+    }
+    writer->first[writer->depth++] = 1;
+    json_writer_append(writer, &bracket, 1);
+}
+
+static void
+json_writer_close(struct json_writer *writer, char bracket)
+{
+    if (writer->depth) {
+        --writer->depth;
+    }
+    json_writer_append(writer, &bracket, 1);
+}
+
+/**
+ * \brief Write a string escaped as JSON requires, without the quotes.
+ */
+static void
+json_writer_escape(struct json_writer *writer, const char *str, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    char esc[6];
+    size_t i, start;
+    unsigned char c;
+
+    /* most strings need no escaping at all, reserve for that */
+    if (json_writer_reserve(writer, len)) {
+        return;
+    }
+
+    for (start = i = 0; i < len; ++i) {
+        c = str[i];
+        if ((c >= 0x20) && (c != '"') && (c != '\\')) {
+            continue;
+        }
+
+        /* copy the run of characters not needing escaping */
+        json_writer_append(writer, str + start, i - start);
+        start = i + 1;
+
+        esc[0] = '\\';
+        switch (c) {
+        case '"':
+        case '\\':
+            esc[1] = c;
+            break;
+        case '\b':
+            esc[1] = 'b';
+            break;
+        case '\f':
+            esc[1] = 'f';
+            break;
+        case '\n':
+            esc[1] = 'n';
+            break;
+        case '\r':
+            esc[1] = 'r';
+            break;
+        case '\t':
+            esc[1] = 't';
+            break;
+        default:
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 0xf];
+            json_writer_append(writer, esc, 6);
+            continue;
+        }
+        json_writer_append(writer, esc, 2);
+    }
+    json_writer_append(writer, str + start, len - start);
+}
+
+void
+json_writer_init(struct json_writer *writer, size_t size_hint)
+{
+    memset(writer, 0, sizeof *writer);
+    if (size_hint) {
+        json_writer_reserve(writer, size_hint);
+    }
+}
+
+void
+json_writer_clean(struct json_writer *writer)
+{
+    free(writer->buf);
+    free(writer->first);
+    memset(writer, 0, sizeof *writer);
+}
+
+const char *
+json_writer_finish(struct json_writer *writer, size_t *len)
+{
+    if (json_writer_reserve(writer, 0)) {
+        return NULL;
+    }
+    writer->buf[writer->len] = '\0';
+    if (len) {
+        *len = writer->len;
+    }
+    return writer->buf;
+}
+
+void
+json_writer_object_start(struct json_writer *writer)
+{
+    json_writer_open(writer, '{');
+}
+
+void
+json_writer_object_end(struct json_writer *writer)
+{
+    json_writer_close(writer, '}');
+}
+
+void
+json_writer_array_start(struct json_writer *writer)
+{
+    json_writer_open(writer, '[');
+}
+
+void
+json_writer_array_end(struct json_writer *writer)
+{
+    json_writer_close(writer, ']');
+}
+
+void
+json_writer_key(struct json_writer *writer, const char *key)
+{
+    json_writer_separate(writer);
+    json_writer_append(writer, "\"", 1);
+    json_writer_escape(writer, key, strlen(key));
+    json_writer_append(writer, "\": ", 3);
+    writer->after_key = 1;
+}
+
+void
+json_writer_string_len(struct json_writer *writer, const char *str, size_t len)
+{
+    json_writer_separate(writer);
+    json_writer_append(writer, "\"", 1);
+    json_writer_escape(writer, str, len);
+    json_writer_append(writer, "\"", 1);
+}
+
+void
+json_writer_string(struct json_writer *writer, const char *str)
+{
+    json_writer_string_len(writer, str, strlen(str));
+}
+
+void
+json_writer_int(struct json_writer *writer, int64_t value)
+{
+    char num[24];
+    int len;
+
+    json_writer_separate(writer);
+    len = sprintf(num, "%" PRId64, value);
+    json_writer_append(writer, num, len);
+}
+
+void
+json_writer_bool(struct json_writer *writer, int value)
+{
+    json_writer_separate(writer);
+    if (value) {
+        json_writer_append(writer, "true", 4);
+    } else {
+        json_writer_append(writer, "false", 5);
+    }
+}
+
+void
+json_writer_raw(struct json_writer *writer, const char *json, size_t len)
+{
+    json_writer_separate(writer);
+    json_writer_append(writer, json, len);
+}
+
+void
+json_writer_object(struct json_writer *writer, json_object *obj)
+{
+    const char *json;
+    size_t len;
+
+    json = json_object_to_json_string_length(obj, JSON_C_TO_STRING_PLAIN, &len);
+    json_writer_raw(writer, json, len);
+}
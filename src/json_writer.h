@@ -0,0 +1,149 @@
+/*!
+ * \file json_writer.h
+ * \brief Append-only JSON writer
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#ifndef _JSON_WRITER_H
+#define _JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <json.h>
+
+/**
+ * \brief Append-only JSON writer.
+ *
+ * JSON text is written straight into a growable buffer without building any
+ * json-c objects. Commas between members and values are added automatically,
+ * the caller only opens and closes containers and writes keys and values.
+ * A failed memory allocation is remembered and reported by json_writer_finish().
+ */
+struct json_writer {
+    char *buf;              /**< written JSON text, not NULL-terminated until finished */
+    size_t len;             /**< number of written bytes */
+    size_t size;            /**< allocated size of buf */
+    unsigned char *first;   /**< for every open container, whether it has no member yet */
+    unsigned int depth;     /**< number of open containers */
+    unsigned int depth_size;/**< allocated size of first */
+    char after_key;         /**< a key was written, its value follows */
+    char error;             /**< memory allocation failed, the output is incomplete */
+};
+
+/**
+ * \brief Initialize a writer
+ * \param[in] writer writer to initialize
+ * \param[in] size_hint expected size of the output, used to allocate the buffer at once
+ */
+void json_writer_init(struct json_writer *writer, size_t size_hint);
+
+/**
+ * \brief Free the memory held by a writer
+ */
+void json_writer_clean(struct json_writer *writer);
+
+/**
+ * \brief Terminate the output
+ * \param[in] writer writer
+ * \param[out] len length of the output, can be NULL
+ * \return NULL-terminated output, it stays owned by the writer; NULL if some allocation failed.
+ */
+const char *json_writer_finish(struct json_writer *writer, size_t *len);
+
+/**
+ * \brief Open an object
+ */
+void json_writer_object_start(struct json_writer *writer);
+
+/**
+ * \brief Close the current object
+ */
+void json_writer_object_end(struct json_writer *writer);
+
+/**
+ * \brief Open an array
+ */
+void json_writer_array_start(struct json_writer *writer);
+
+/**
+ * \brief Close the current array
+ */
+void json_writer_array_end(struct json_writer *writer);
+
+/**
+ * \brief Write the key of the next object member
+ */
+void json_writer_key(struct json_writer *writer, const char *key);
+
+/**
+ * \brief Write a string value
+ * \param[in] writer writer
+ * \param[in] str string, it is escaped as needed
+ * \param[in] len length of str
+ */
+void json_writer_string_len(struct json_writer *writer, const char *str, size_t len);
+
+/**
+ * \brief Write a NULL-terminated string value
+ */
+void json_writer_string(struct json_writer *writer, const char *str);
+
+/**
+ * \brief Write an integer value
+ */
+void json_writer_int(struct json_writer *writer, int64_t value);
+
+/**
+ * \brief Write a boolean value
+ */
+void json_writer_bool(struct json_writer *writer, int value);
+
+/**
+ * \brief Write a value that is already valid JSON text
+ * \param[in] writer writer
+ * \param[in] json JSON text, it is copied as it is
+ * \param[in] len length of json
+ */
+void json_writer_raw(struct json_writer *writer, const char *json, size_t len);
+
+/**
+ * \brief Write a json-c object as a value
+ */
+void json_writer_object(struct json_writer *writer, json_object *obj);
+
+#endif
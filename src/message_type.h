@@ -66,6 +66,7 @@ typedef enum MSG_TYPE {
     MSG_NTF_GETHISTORY,
     MSG_VALIDATE,
     MSG_COMMIT,
+    MSG_EXPAND,
     SCH_QUERY = 100,
     SCH_MERGE = 101
 } MSG_TYPE;
@@ -0,0 +1,445 @@
+/*!
+ * \file metadata_cache.c
+ * \brief Cache of serialized schema node metadata
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <nc_client.h>
+
+#include "netopeerguid.h"
+#include "json_writer.h"
+#include "metadata_cache.h"
+
+#define METADATA_CACHE_MIN_SIZE 64
+
+struct metadata_entry {
+    const struct lys_node *node;    /**< schema node, NULL for an empty slot */
+    char *json[METADATA_FULL + 1];  /**< serialized metadata of every level, NULL until rendered */
+    size_t len[METADATA_FULL + 1];  /**< length of json */
+    char *path;                     /**< schema path of the node */
+};
+
+/**
+ * \brief Open-addressing hash table of metadata indexed by the schema node address.
+ */
+struct metadata_cache {
+    pthread_rwlock_t lock;          /**< protects the members below */
+    struct metadata_entry *entries;
+    unsigned int size;              /**< number of slots, a power of 2 */
+    unsigned int count;             /**< number of used slots */
+};
+
+struct metadata_dict_entry {
+    char *key;                      /**< schema path, NULL for an empty slot */
+    char *json;                     /**< serialized metadata */
+    size_t len;                     /**< length of json */
+};
+
+/**
+ * \brief Open-addressing hash table of metadata indexed by their key.
+ */
+struct metadata_dict {
+    pthread_mutex_t lock;           /**< protects the members below */
+    struct metadata_dict_entry *entries;
+    unsigned int size;              /**< number of slots, a power of 2 */
+    unsigned int count;             /**< number of used slots */
+};
+
+static unsigned int
+metadata_cache_hash(const struct lys_node *node, unsigned int size)
+{
+    uint64_t key = (uintptr_t)node;
+
+    /* Fibonacci hashing, the low bits of an address are mostly the same */
+    return (unsigned int)((key * UINT64_C(11400714819323198485)) >> 32) & (size - 1);
+}
+
+static struct metadata_entry *
+metadata_cache_slot(struct metadata_entry *entries, unsigned int size, const struct lys_node *node)
+{
+    unsigned int i;
+
+    for (i = metadata_cache_hash(node, size); entries[i].node && (entries[i].node != node); i = (i + 1) & (size - 1));
+    return &entries[i];
+}
+
+/**
+ * \brief Double the size of the table, the write lock must be held.
+ */
+static int
+metadata_cache_grow(struct metadata_cache *cache)
+{
+    struct metadata_entry *entries;
+    unsigned int i, size;
+
+    size = cache->size ? 2 * cache->size : METADATA_CACHE_MIN_SIZE;
+    entries = calloc(size, sizeof *entries);
+    if (!entries) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        return 1;
+    }
+    for (i = 0; i < cache->size; ++i) {
+        if (cache->entries[i].node) {
+            *metadata_cache_slot(entries, size, cache->entries[i].node) = cache->entries[i];
+        }
+    }
+    free(cache->entries);
+    cache->entries = entries;
+    cache->size = size;
+    return 0;
+}
+
+struct metadata_cache *
+metadata_cache_new(void)
+{
+    struct metadata_cache *cache;
+
+    cache = calloc(1, sizeof *cache);
+    if (!cache) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        return NULL;
+    }
+    pthread_rwlock_init(&cache->lock, NULL);
+    return cache;
+}
+
+void
+metadata_cache_free(struct metadata_cache *cache)
+{
+    unsigned int i;
+
+    if (!cache) {
+        return;
+    }
+    for (i = 0; i < cache->size; ++i) {
+        free(cache->entries[i].json[METADATA_MINIMAL]);
+        free(cache->entries[i].json[METADATA_FULL]);
+        free(cache->entries[i].path);
+    }
+    free(cache->entries);
+    pthread_rwlock_destroy(&cache->lock);
+    free(cache);
+}
+
+/**
+ * \brief Get the cached metadata of a schema node, render them on the first use.
+ *
+ * \param[in] cache cache
+ * \param[in] node schema node
+ * \param[in] level level of the metadata, with METADATA_NONE only the path is returned
+ * \param[out] json rendered metadata
+ * \param[out] len length of json
+ * \param[out] path schema path of the node
+ * \return 0 on success, 1 on error.
+ */
+static int
+metadata_cache_get(struct metadata_cache *cache, const struct lys_node *node, enum metadata_level level,
+                   const char **json, size_t *len, const char **path)
+{
+    struct metadata_entry *entry;
+    char *new_json = NULL, *new_path = NULL;
+    size_t new_len = 0;
+    int ret = 0;
+
+    pthread_rwlock_rdlock(&cache->lock);
+    if (cache->size) {
+        entry = metadata_cache_slot(cache->entries, cache->size, node);
+        if (entry->node && ((level == METADATA_NONE) || entry->json[level])) {
+            /* the table can be reallocated, but cached metadata are freed only with the cache */
+            *json = entry->json[level];
+            *len = entry->len[level];
+            *path = entry->path;
+            pthread_rwlock_unlock(&cache->lock);
+            return 0;
+        }
+    }
+    pthread_rwlock_unlock(&cache->lock);
+
+    if (level != METADATA_NONE) {
+        new_json = node_metadata_json(node, level == METADATA_MINIMAL, &new_len);
+    }
+    new_path = lys_data_path(node);
+    if (((level != METADATA_NONE) && !new_json) || !new_path) {
+        ERROR("Rendering metadata of \"%s\" failed.", node->name);
+        free(new_json);
+        free(new_path);
+        return 1;
+    }
+
+    pthread_rwlock_wrlock(&cache->lock);
+    /* the node may have been added by another thread meanwhile */
+    entry = cache->size ? metadata_cache_slot(cache->entries, cache->size, node) : NULL;
+    if (!entry || !entry->node) {
+        /* keep the table at most 3/4 full */
+        if ((4 * (cache->count + 1) > 3 * cache->size) && metadata_cache_grow(cache)) {
+            ret = 1;
+            goto unlock;
+        }
+        entry = metadata_cache_slot(cache->entries, cache->size, node);
+        entry->node = node;
+        entry->path = new_path;
+        ++cache->count;
+        new_path = NULL;
+    }
+    if ((level != METADATA_NONE) && !entry->json[level]) {
+        entry->json[level] = new_json;
+        entry->len[level] = new_len;
+        new_json = NULL;
+    }
+    *json = entry->json[level];
+    *len = entry->len[level];
+    *path = entry->path;
+
+unlock:
+    pthread_rwlock_unlock(&cache->lock);
+    free(new_json);
+    free(new_path);
+    return ret;
+}
+
+void
+metadata_cache_write(struct metadata_cache *cache, struct json_writer *writer, const struct lys_node *node,
+                     enum metadata_level level)
+{
+    const char *json, *path;
+    size_t len;
+
+    if (metadata_cache_get(cache, node, level, &json, &len, &path)) {
+        writer->error = 1;
+        return;
+    }
+    json_writer_raw(writer, json, len);
+}
+
+const char *
+metadata_cache_path(struct metadata_cache *cache, const struct lys_node *node)
+{
+    const char *json, *path;
+    size_t len;
+
+    if (metadata_cache_get(cache, node, METADATA_NONE, &json, &len, &path)) {
+        return NULL;
+    }
+    return path;
+}
+
+static uint32_t
+metadata_dict_hash(const char *key)
+{
+    uint32_t hash = 2166136261u;
+
+    /* FNV-1a */
+    for (; *key; ++key) {
+        hash = (hash ^ (unsigned char)*key) * 16777619u;
+    }
+    return hash;
+}
+
+static struct metadata_dict_entry *
+metadata_dict_slot(struct metadata_dict_entry *entries, unsigned int size, const char *key)
+{
+    unsigned int i;
+
+    for (i = metadata_dict_hash(key) & (size - 1); entries[i].key && strcmp(entries[i].key, key); i = (i + 1) & (size - 1));
+    return &entries[i];
+}
+
+/**
+ * \brief Double the size of the table, the lock must be held.
+ */
+static int
+metadata_dict_grow(struct metadata_dict *dict)
+{
+    struct metadata_dict_entry *entries;
+    unsigned int i, size;
+
+    size = dict->size ? 2 * dict->size : METADATA_CACHE_MIN_SIZE;
+    entries = calloc(size, sizeof *entries);
+    if (!entries) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        return 1;
+    }
+    for (i = 0; i < dict->size; ++i) {
+        if (dict->entries[i].key) {
+            *metadata_dict_slot(entries, size, dict->entries[i].key) = dict->entries[i];
+        }
+    }
+    free(dict->entries);
+    dict->entries = entries;
+    dict->size = size;
+    return 0;
+}
+
+struct metadata_dict *
+metadata_dict_new(void)
+{
+    struct metadata_dict *dict;
+
+    dict = calloc(1, sizeof *dict);
+    if (!dict) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        return NULL;
+    }
+    pthread_mutex_init(&dict->lock, NULL);
+    return dict;
+}
+
+void
+metadata_dict_free(struct metadata_dict *dict)
+{
+    unsigned int i;
+
+    if (!dict) {
+        return;
+    }
+    for (i = 0; i < dict->size; ++i) {
+        free(dict->entries[i].key);
+        free(dict->entries[i].json);
+    }
+    free(dict->entries);
+    pthread_mutex_destroy(&dict->lock);
+    free(dict);
+}
+
+/**
+ * \brief Find the key of metadata in the dictionary, add them if they are not there yet.
+ *
+ * The key is the schema path of the node. Metadata of the same path that differ
+ * (sessions with different revisions of a module) get the path with a "#<n>" suffix.
+ * The lock must be held.
+ *
+ * \return Key of the metadata, NULL on error.
+ */
+static const char *
+metadata_dict_add(struct metadata_dict *dict, const char *path, const char *json, size_t len)
+{
+    struct metadata_dict_entry *entry;
+    char *key = NULL;
+    unsigned int n;
+
+    for (n = 1; ; ++n) {
+        if (n > 1) {
+            free(key);
+            if (asprintf(&key, "%s#%u", path, n) == -1) {
+                key = NULL;
+                goto error;
+            }
+        }
+        if (dict->size) {
+            entry = metadata_dict_slot(dict->entries, dict->size, key ? key : path);
+            if (!entry->key) {
+                break;
+            }
+            if ((entry->len == len) && !memcmp(entry->json, json, len)) {
+                free(key);
+                return entry->key;
+            }
+        } else {
+            break;
+        }
+    }
+
+    /* not found, add it */
+    if ((4 * (dict->count + 1) > 3 * dict->size) && metadata_dict_grow(dict)) {
+        goto error;
+    }
+    if (!key && !(key = strdup(path))) {
+        goto error;
+    }
+    entry = metadata_dict_slot(dict->entries, dict->size, key);
+    entry->json = malloc(len);
+    if (!entry->json) {
+        goto error;
+    }
+    memcpy(entry->json, json, len);
+    entry->key = key;
+    entry->len = len;
+    ++dict->count;
+    return entry->key;
+
+error:
+    ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+    free(key);
+    return NULL;
+}
+
+void
+metadata_dict_write_ref(struct metadata_dict *dict, struct metadata_cache *cache, struct json_writer *writer,
+                        const struct lys_node *node, enum metadata_level level)
+{
+    const char *json, *path, *key;
+    size_t len;
+
+    if (metadata_cache_get(cache, node, level, &json, &len, &path)) {
+        writer->error = 1;
+        return;
+    }
+
+    pthread_mutex_lock(&dict->lock);
+    key = metadata_dict_add(dict, path, json, len);
+    if (key) {
+        /* keys are freed only with the dictionary */
+        json_writer_string(writer, key);
+    } else {
+        writer->error = 1;
+    }
+    pthread_mutex_unlock(&dict->lock);
+}
+
+void
+metadata_dict_write(struct metadata_dict *dict, struct json_writer *writer)
+{
+    unsigned int i;
+
+    json_writer_object_start(writer);
+    pthread_mutex_lock(&dict->lock);
+    for (i = 0; i < dict->size; ++i) {
+        if (dict->entries[i].key) {
+            json_writer_key(writer, dict->entries[i].key);
+            json_writer_raw(writer, dict->entries[i].json, dict->entries[i].len);
+        }
+    }
+    pthread_mutex_unlock(&dict->lock);
+    json_writer_object_end(writer);
+}
@@ -0,0 +1,134 @@
+/*!
+ * \file metadata_cache.h
+ * \brief Cache of serialized schema node metadata
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#ifndef _METADATA_CACHE_H
+#define _METADATA_CACHE_H
+
+#include <stddef.h>
+#include <libyang/libyang.h>
+
+#include "json_writer.h"
+
+/**
+ * \brief Amount of schema metadata added to data.
+ */
+enum metadata_level {
+    METADATA_NONE,      /**< no metadata */
+    METADATA_MINIMAL,   /**< structure only: element type, config, type and keys */
+    METADATA_FULL       /**< everything, including descriptions, references and restrictions */
+};
+
+/**
+ * \brief Serialized metadata of the schema nodes of one libyang context.
+ *
+ * The metadata of a schema node do not change while its context exists, so
+ * they are rendered on the first use and then only copied into the output.
+ * The cache is owned by the session holding the context and can be used by
+ * several threads at once.
+ */
+struct metadata_cache;
+
+/**
+ * \brief Metadata collected from the data of a reply, each of them stored once.
+ *
+ * Instead of the metadata themselves, the data carry the key of the metadata in
+ * the dictionary. The key is the schema path of the node. The dictionary can be
+ * shared by the threads processing the sessions of one request.
+ */
+struct metadata_dict;
+
+/**
+ * \brief Create an empty cache
+ * \return New cache, NULL on memory allocation failure.
+ */
+struct metadata_cache *metadata_cache_new(void);
+
+/**
+ * \brief Free a cache with all the cached metadata
+ */
+void metadata_cache_free(struct metadata_cache *cache);
+
+/**
+ * \brief Write the metadata of a schema node as a JSON object value
+ * \param[in] cache cache of the context of the node
+ * \param[in] writer writer to write the metadata to
+ * \param[in] node schema node
+ * \param[in] level level of the metadata, not METADATA_NONE
+ */
+void metadata_cache_write(struct metadata_cache *cache, struct json_writer *writer, const struct lys_node *node,
+                          enum metadata_level level);
+
+/**
+ * \brief Get the schema path of a node
+ * \param[in] cache cache of the context of the node
+ * \param[in] node schema node
+ * \return Path of the node valid as long as the cache, NULL on error.
+ */
+const char *metadata_cache_path(struct metadata_cache *cache, const struct lys_node *node);
+
+/**
+ * \brief Create an empty dictionary
+ * \return New dictionary, NULL on memory allocation failure.
+ */
+struct metadata_dict *metadata_dict_new(void);
+
+/**
+ * \brief Free a dictionary
+ */
+void metadata_dict_free(struct metadata_dict *dict);
+
+/**
+ * \brief Add the metadata of a schema node to a dictionary and write their key as a string value
+ * \param[in] dict dictionary
+ * \param[in] cache cache of the context of the node
+ * \param[in] writer writer to write the key to
+ * \param[in] node schema node
+ * \param[in] level level of the metadata, not METADATA_NONE
+ */
+void metadata_dict_write_ref(struct metadata_dict *dict, struct metadata_cache *cache, struct json_writer *writer,
+                             const struct lys_node *node, enum metadata_level level);
+
+/**
+ * \brief Write all the metadata of a dictionary as a JSON object indexed by their keys
+ */
+void metadata_dict_write(struct metadata_dict *dict, struct json_writer *writer);
+
+#endif
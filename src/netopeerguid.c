@@ -53,7 +53,10 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <sys/stat.h>
 #include <pwd.h>
 #include <syslog.h>
@@ -74,17 +77,32 @@
 
 #include "message_type.h"
 #include "netopeerguid.h"
+#include "worker_pool.h"
+#include "json_writer.h"
+#include "metadata_cache.h"
+#include "config_cache.h"
+#include "single_flight.h"
+#include "snapshot.h"
+#include "session_table.h"
+#include "session_timer.h"
+#include "rpc_dispatch.h"
+#include "data_printer.h"
 
 #define SCHEMA_DIR "/tmp/yang_models"
 #define MAX_PROCS 5
 #define SOCKET_FILENAME "/var/run/netopeerguid.sock"
 #define MAX_SOCKET_CL 10
 #define BUFFER_SIZE 4096
+#define SEND_TIMEOUT 30000  /**< timeout in msec for the frontend socket to become writable */
 #define ACTIVITY_CHECK_INTERVAL 10  /**< timeout in seconds, how often activity is checked */
 #define ACTIVITY_TIMEOUT    (60*60)  /**< timeout in seconds, after this time, session is automaticaly closed. */
 
-/* sleep in master process for non-blocking socket reading, in msec */
-#define SLEEP_TIME 200
+#define REACTOR_MAX_EVENTS 64  /**< maximal number of events handled in one epoll_wait() */
+#define REACTOR_TICK 1  /**< period in seconds of the main loop timer */
+#define DEFAULT_WORKERS 8  /**< default number of threads processing frontend requests */
+#define DEFAULT_FANOUT 16  /**< default number of sessions of a single request processed in parallel */
+#define DEFAULT_CONFIG_CACHE_TTL 10  /**< default lifetime in seconds of cached get-config results */
+#define CONN_MAX_PENDING 16  /**< queued and processed requests of a connection, reading it is suspended when reached */
 
 #ifndef offsetof
 #define offsetof(type, member) ((size_t) ((type *) 0)->member)
@@ -102,27 +120,43 @@ struct timeval timeout = { 1, 0 };
 #define MSG_ERROR 4
 #define MSG_UNKNOWN 5
 
-pthread_rwlock_t session_lock; /**< mutex protecting netconf_sessions_list from multiple access errors */
+pthread_rwlock_t session_lock; /**< mutex protecting netconf_sessions_list and session_index from multiple access errors */
+static pthread_mutex_t session_ref_lock = PTHREAD_MUTEX_INITIALIZER; /**< mutex protecting the reference counts of the sessions */
 pthread_mutex_t ntf_history_lock; /**< mutex protecting notification history list */
 pthread_mutex_t ntf_hist_clbc_mutex; /**< mutex protecting notification history list */
-pthread_mutex_t json_lock; /**< mutex for protecting json-c calls */
 
 unsigned int session_key_generator = 1;
 struct session_with_mutex *netconf_sessions_list = NULL;
+struct session_table session_index; /**< netconf_sessions_list indexed by session_key and NETCONF session-id */
+static struct session_timer session_idle; /**< expiration of the idle sessions of netconf_sessions_list */
+static pthread_t reaper_thread; /**< thread closing the expired sessions */
+static pthread_mutex_t reaper_lock = PTHREAD_MUTEX_INITIALIZER; /**< mutex protecting reaper_stop */
+static pthread_cond_t reaper_cond = PTHREAD_COND_INITIALIZER; /**< signalled to stop the reaper thread */
+static int reaper_stop;
 static const char *sockname;
 static pthread_key_t notif_history_key;
 pthread_key_t err_reply_key;
 volatile int isterminated = 0;
+static volatile int report_stats = 0;
 static char* password;
 int daemonize;
 
+static const char data_is_json; /**< userdata marking the data of a DATA reply as JSON text */
+static struct worker_pool *workers; /**< threads processing frontend requests */
+static unsigned int worker_count = DEFAULT_WORKERS;
+static unsigned int fanout_limit = DEFAULT_FANOUT; /**< sessions of a request processed in parallel */
+static unsigned int config_cache_ttl = DEFAULT_CONFIG_CACHE_TTL; /**< lifetime of cached get-config results, 0 disables caching */
+static int reactor_fd = -1; /**< epoll instance of the main loop */
+static struct client_conn **conn_table; /**< frontend connections indexed by their socket */
+static int conn_table_size;
+static unsigned int conn_count;
+
 json_object *create_ok_reply(void);
 json_object *create_data_reply(const char *data);
 static char *netconf_getschema(unsigned int session_key, const char *identifier, const char *version,
                                const char *format, json_object **err);
-static void node_add_metadata_recursive(struct lyd_node *data_tree, const struct lys_module *module,
-                                        json_object *data_json_parent);
 static void node_metadata_typedef(struct lys_tpdf *tpdf, json_object *parent);
+static void conn_send_replies(struct client_conn *conn, json_object *replies, json_object *request);
 
 static void
 signal_handler(int sign)
@@ -132,6 +166,9 @@ signal_handler(int sign)
     case SIGTERM:
         isterminated = 1;
         break;
+    case SIGUSR1:
+        report_stats = 1;
+        break;
     }
 }
 
@@ -180,7 +217,6 @@ netconf_callback_error_process(const char *message)
     json_object *array = NULL;
     if (err_reply == NULL) {
         ERROR("error calback: empty error list");
-        pthread_mutex_lock(&json_lock);
         err_reply = json_object_new_object();
         array = json_object_new_array();
         json_object_object_add(err_reply, "type", json_object_new_int(REPLY_ERROR));
@@ -188,17 +224,14 @@ netconf_callback_error_process(const char *message)
         if (message != NULL) {
             json_object_array_add(array, json_object_new_string(message));
         }
-        pthread_mutex_unlock(&json_lock);
         (*err_reply_p) = err_reply;
     } else {
         ERROR("error calback: nonempty error list");
-        pthread_mutex_lock(&json_lock);
         if (json_object_object_get_ex(err_reply, "errors", &array) == TRUE) {
             if (message != NULL) {
                 json_object_array_add(array, json_object_new_string(message));
             }
         }
-        pthread_mutex_unlock(&json_lock);
     }
     pthread_setspecific(err_reply_key, err_reply_p);
     return;
@@ -224,7 +257,6 @@ prepare_status_message(struct session_with_mutex *s, struct nc_session *session)
         return;
     }
 
-    pthread_mutex_lock(&json_lock);
     if (s->hello_message != NULL) {
         ERROR("clean previous hello message");
         if (json_object_object_get_ex(s->hello_message, "sid", &js_tmp) == TRUE) {
@@ -285,7 +317,18 @@ prepare_status_message(struct session_with_mutex *s, struct nc_session *session)
         json_object_object_add(s->hello_message, "error-message", json_object_new_string("Invalid session identifier."));
     }
     DEBUG("Status info from hello message prepared");
-    pthread_mutex_unlock(&json_lock);
+}
+
+/**
+ * \brief Get a private copy of the hello message of a session.
+ *
+ * json-c objects are not thread-safe, so the message shared by all the users of
+ * the session is never handed out itself. Session lock is expected to be held.
+ */
+static json_object *
+session_hello_copy(struct session_with_mutex *s)
+{
+    return json_tokener_parse(json_object_to_json_string(s->hello_message));
 }
 
 void
@@ -307,9 +350,7 @@ clean_err_reply()
     json_object **err_reply = (json_object **) pthread_getspecific(err_reply_key);
     if (err_reply != NULL) {
         if (*err_reply != NULL) {
-            pthread_mutex_lock(&json_lock);
             json_object_put(*err_reply);
-            pthread_mutex_unlock(&json_lock);
             *err_reply = NULL;
         }
         if (pthread_setspecific(err_reply_key, err_reply) != 0) {
@@ -324,9 +365,7 @@ free_err_reply()
     json_object **err_reply = (json_object **) pthread_getspecific(err_reply_key);
     if (err_reply != NULL) {
         if (*err_reply != NULL) {
-            pthread_mutex_lock(&json_lock);
             json_object_put(*err_reply);
-            pthread_mutex_unlock(&json_lock);
         }
         free(err_reply);
         err_reply = NULL;
@@ -336,56 +375,144 @@ free_err_reply()
     }
 }
 
+/**
+ * \brief Free a session no longer referenced, it must not be in netconf_sessions_list
+ */
+static void
+session_free(struct session_with_mutex *locked_session)
+{
+    int i;
+
+    for (i = 0; i < locked_session->notif_count; ++i) {
+        free(locked_session->notifications[i].content);
+    }
+    free(locked_session->notifications);
+    if (locked_session->hello_message != NULL) {
+        json_object_put(locked_session->hello_message);
+    }
+    /* cached data belong to the session context */
+    config_cache_free(locked_session->config_cache);
+    snapshot_store_free(locked_session->snapshots);
+    metadata_cache_free(locked_session->metadata_cache);
+    flight_group_free(locked_session->flights);
+    rpc_dispatcher_free(locked_session->dispatcher);
+    if (locked_session->session != NULL) {
+        nc_session_free(locked_session->session, NULL);
+    }
+    pthread_mutex_destroy(&locked_session->lock);
+    free(locked_session);
+    DEBUG("NETCONF session closed, everything cleared.");
+}
+
+void
+session_ref(struct session_with_mutex *locked_session)
+{
+    pthread_mutex_lock(&session_ref_lock);
+    ++locked_session->refcount;
+    pthread_mutex_unlock(&session_ref_lock);
+}
+
+void
+session_put(struct session_with_mutex *locked_session)
+{
+    unsigned int refcount;
+
+    pthread_mutex_lock(&session_ref_lock);
+    refcount = --locked_session->refcount;
+    pthread_mutex_unlock(&session_ref_lock);
+
+    if (!refcount) {
+        session_free(locked_session);
+    }
+}
+
+/**
+ * \brief Note activity of the user of a session, it keeps all the sessions of the user open
+ *
+ * The session must be in netconf_sessions_list and session_lock held. Concurrent
+ * requests note the activity under the read lock, so the time is stored atomically,
+ * it is read only under the write lock.
+ */
+static void
+session_user_activity(struct session_with_mutex *locked_session)
+{
+    __atomic_store_n(&locked_session->user->last_activity, time(NULL), __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief Get a reference to a session for a request, session_lock is held only for the lookup
+ *
+ * \param[in] session_key session identifier
+ * \param[out] err error reply, can be NULL
+ * \return Session to be released by session_put(), NULL if there is no such session.
+ */
 static struct session_with_mutex *
-session_get_locked(unsigned int session_key, json_object **err)
+session_get(unsigned int session_key, json_object **err)
 {
     struct session_with_mutex *locked_session;
 
     /* get non-exclusive (read) access to sessions_list (conns) */
-    DEBUG("LOCK wrlock %s", __func__);
+    DEBUG("LOCK rdlock %s", __func__);
     if (pthread_rwlock_rdlock(&session_lock) != 0) {
-        if (*err) {
+        if (err) {
             *err = create_error_reply("Locking failed.");
         }
         return NULL;
     }
-    /* get session where to send the RPC */
-    for (locked_session = netconf_sessions_list;
-         locked_session && (locked_session->session_key != session_key);
-         locked_session = locked_session->next);
+    locked_session = session_table_find(&session_index, session_key);
+    if (locked_session) {
+        session_ref(locked_session);
+        session_user_activity(locked_session);
+    }
+    DEBUG("UNLOCK rdlock %s", __func__);
+    pthread_rwlock_unlock(&session_lock);
+
+    if (!locked_session && err) {
+        *err = create_error_reply("Session not found.");
+    }
+    return locked_session;
+}
+
+/**
+ * \brief Get exclusive access to a session for a request
+ *
+ * Only the session is locked, session_lock is released before waiting for the
+ * session, so other sessions can be connected and closed meanwhile. RPCs are
+ * sent by the dispatcher of the session and do not need the lock.
+ *
+ * \param[in] session_key session identifier
+ * \param[out] err error reply, can be NULL
+ * \return Locked session to be released by session_unlock(), NULL on error.
+ */
+static struct session_with_mutex *
+session_get_locked(unsigned int session_key, json_object **err)
+{
+    struct session_with_mutex *locked_session;
+
+    locked_session = session_get(session_key, err);
     if (!locked_session) {
-        if (*err) {
-            *err = create_error_reply("Session not found.");
-        }
-        goto rwlock_fail;
+        return NULL;
     }
 
     /* get exclusive access to session */
     DEBUG("LOCK mutex %s", __func__);
     if (pthread_mutex_lock(&locked_session->lock) != 0) {
-        if (*err) {
+        if (err) {
             *err = create_error_reply("Locking failed.");
         }
-        goto rwlock_fail;
+        session_put(locked_session);
+        return NULL;
     }
-    return locked_session;
-
-rwlock_fail:
-    DEBUG("UNLOCK wrlock %s", __func__);
-    pthread_rwlock_unlock(&session_lock);
-    return NULL;
-}
-
-static void
-session_user_activity(const char *username)
-{
-    struct session_with_mutex *sess;
-
-    for (sess = netconf_sessions_list; sess; sess = sess->next) {
-        if (!strcmp(nc_session_get_username(sess->session), username)) {
-            sess->last_activity = time(NULL);
+    if (locked_session->closed) {
+        /* closed while waiting for the lock */
+        if (err) {
+            *err = create_error_reply("Session not found.");
         }
+        pthread_mutex_unlock(&locked_session->lock);
+        session_put(locked_session);
+        return NULL;
     }
+    return locked_session;
 }
 
 static void
@@ -393,8 +520,7 @@ session_unlock(struct session_with_mutex *locked_session)
 {
     DEBUG("UNLOCK mutex %s", __func__);
     pthread_mutex_unlock(&locked_session->lock);
-    DEBUG("UNLOCK wrlock %s", __func__);
-    pthread_rwlock_unlock(&session_lock);
+    session_put(locked_session);
 }
 
 static void
@@ -1165,7 +1291,7 @@ static unsigned int
 netconf_connect(const char *host, const char *port, const char *user, const char *pass, const char *privkey)
 {
     struct nc_session* session = NULL;
-    struct session_with_mutex *locked_session, *last_session;
+    struct session_with_mutex *locked_session;
     char *pubkey;
 
     /* connect to the requested NETCONF server */
@@ -1196,26 +1322,54 @@ netconf_connect(const char *host, const char *port, const char *user, const char
         }
         locked_session->session = session;
         locked_session->hello_message = NULL;
+        locked_session->metadata_cache = metadata_cache_new();
+        if (config_cache_ttl) {
+            locked_session->config_cache = config_cache_new(config_cache_ttl);
+        }
+        locked_session->flights = flight_group_new();
+        locked_session->snapshots = snapshot_store_new();
         locked_session->closed = 0;
-        pthread_mutex_init(&locked_session->lock, NULL);
+        /* the reference of netconf_sessions_list */
+        locked_session->refcount = 1;
+        if ((locked_session->dispatcher = rpc_dispatcher_new(session)) == NULL) {
+            session_free(locked_session);
+            return 0;
+        }
         DEBUG("Before session_lock");
         /* get exclusive access to sessions_list (conns) */
         DEBUG("LOCK wrlock %s", __func__);
         if (pthread_rwlock_wrlock(&session_lock) != 0) {
-            nc_session_free(session, NULL);
-            free(locked_session);
+            session_free(locked_session);
             ERROR("Error while locking rwlock: %d (%s)", errno, strerror(errno));
             return 0;
         }
+        /* the generator wraps around, skip the keys of long-lived sessions */
+        while (session_table_find(&session_index, session_key_generator)) {
+            ++session_key_generator;
+            if (session_key_generator == UINT_MAX) {
+                session_key_generator = 1;
+            }
+        }
+        locked_session->session_key = session_key_generator;
+        ++session_key_generator;
+        if (session_key_generator == UINT_MAX) {
+            session_key_generator = 1;
+        }
+        locked_session->sid = nc_session_get_id(session);
+
         DEBUG("Add connection to the list");
-        if (!netconf_sessions_list) {
-            netconf_sessions_list = locked_session;
-        } else {
-            for (last_session = netconf_sessions_list; last_session->next; last_session = last_session->next);
-            last_session->next = locked_session;
-            locked_session->prev = last_session;
+        if (session_table_add(&session_index, locked_session, nc_session_get_username(session))) {
+            pthread_rwlock_unlock(&session_lock);
+            session_free(locked_session);
+            return 0;
+        }
+        locked_session->next = netconf_sessions_list;
+        if (netconf_sessions_list) {
+            netconf_sessions_list->prev = locked_session;
         }
-        session_user_activity(nc_session_get_username(locked_session->session));
+        netconf_sessions_list = locked_session;
+        session_user_activity(locked_session);
+        session_timer_add(&session_idle, locked_session);
 
         /* no need to lock session, noone can read it while we have wrlock */
 
@@ -1223,11 +1377,6 @@ netconf_connect(const char *host, const char *port, const char *user, const char
         prepare_status_message(locked_session, session);
 
         DEBUG("NETCONF session established");
-        locked_session->session_key = session_key_generator;
-        ++session_key_generator;
-        if (session_key_generator == UINT_MAX) {
-            session_key_generator = 1;
-        }
 
         DEBUG("Before session_unlock");
         /* unlock session list */
@@ -1243,44 +1392,51 @@ netconf_connect(const char *host, const char *port, const char *user, const char
     return 0;
 }
 
+/**
+ * \brief Close a session removed from netconf_sessions_list
+ *
+ * Requests waiting for the session fail, the session is freed when the last
+ * of the requests using it releases its reference.
+ */
 static int
 close_and_free_session(struct session_with_mutex *locked_session)
 {
-    int i;
-
     DEBUG("LOCK mutex %s", __func__);
     if (pthread_mutex_lock(&locked_session->lock) != 0) {
         ERROR("Error while locking rwlock");
     }
     locked_session->closed = 1;
-    if (locked_session->session != NULL) {
-        nc_session_free(locked_session->session, NULL);
-        locked_session->session = NULL;
-    }
     DEBUG("session closed.");
     DEBUG("UNLOCK mutex %s", __func__);
     if (pthread_mutex_unlock(&locked_session->lock) != 0) {
         ERROR("Error while locking rwlock");
     }
+    /* the RPCs in progress fail */
+    rpc_dispatcher_stop(locked_session->dispatcher);
 
-    DEBUG("closed session, disabled notif(?), wait 0.5s");
-    usleep(500000); /* let notification thread stop */
+    /* the reference of netconf_sessions_list; the notification thread cannot find
+     * the session anymore, nc_session_free() joins it with the last reference */
+    session_put(locked_session);
+    return (EXIT_SUCCESS);
+}
 
-    /* session shouldn't be used by now */
-    for (i = 0; i < locked_session->notif_count; ++i) {
-        free(locked_session->notifications[i].content);
+/**
+ * \brief Remove a session from netconf_sessions_list and session_index, session_lock must be write-locked
+ */
+static void
+session_list_remove(struct session_with_mutex *locked_session)
+{
+    session_table_remove(&session_index, locked_session);
+    session_timer_remove(&session_idle, locked_session);
+    if (!locked_session->prev) {
+        netconf_sessions_list = locked_session->next;
+    } else {
+        locked_session->prev->next = locked_session->next;
     }
-    free(locked_session->notifications);
-    pthread_mutex_destroy(&locked_session->lock);
-    if (locked_session->hello_message != NULL) {
-        json_object_put(locked_session->hello_message);
-        locked_session->hello_message = NULL;
+    if (locked_session->next) {
+        locked_session->next->prev = locked_session->prev;
     }
-    locked_session->session = NULL;
-    free(locked_session);
-    locked_session = NULL;
-    DEBUG("NETCONF session closed, everything cleared.");
-    return (EXIT_SUCCESS);
+    locked_session->prev = locked_session->next = NULL;
 }
 
 static int
@@ -1298,9 +1454,7 @@ netconf_close(unsigned int session_key, json_object **reply)
         return EXIT_FAILURE;
     }
     /* remove session from the active sessions list -> nobody new can now work with session */
-    for (locked_session = netconf_sessions_list;
-         locked_session && (locked_session->session_key != session_key);
-         locked_session = locked_session->next);
+    locked_session = session_table_find(&session_index, session_key);
 
     if (!locked_session) {
         DEBUG("UNLOCK wrlock %s", __func__);
@@ -1310,17 +1464,7 @@ netconf_close(unsigned int session_key, json_object **reply)
         return EXIT_FAILURE;
     }
 
-    if (!locked_session->prev) {
-        netconf_sessions_list = netconf_sessions_list->next;
-        if (netconf_sessions_list) {
-            netconf_sessions_list->prev = NULL;
-        }
-    } else {
-        locked_session->prev->next = locked_session->next;
-        if (locked_session->next) {
-            locked_session->next->prev = locked_session->prev;
-        }
-    }
+    session_list_remove(locked_session);
 
     DEBUG("UNLOCK wrlock %s", __func__);
     if (pthread_rwlock_unlock (&session_lock) != 0) {
@@ -1438,9 +1582,34 @@ netconf_unlocked_op(struct nc_session *session, struct nc_rpc *rpc)
     }
 }
 
+/**
+ * \brief Check whether an RPC may change a configuration datastore.
+ *
+ * Generic RPCs are unknown to us, they are considered to change it.
+ */
+static int
+rpc_modifies_config(struct nc_rpc *rpc)
+{
+    switch (nc_rpc_get_type(rpc)) {
+    case NC_RPC_EDIT:
+    case NC_RPC_COPY:
+    case NC_RPC_DELETE:
+    case NC_RPC_COMMIT:
+    case NC_RPC_DISCARD:
+    case NC_RPC_CANCEL:
+    case NC_RPC_ACT_GENERIC:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
 /**
  * Perform RPC method that returns data.
  *
+ * The received data are in the context of the session, the caller must hold
+ * a reference to the session (see session_get()) until it frees them.
+ *
  * \param[in] session_id    session identifier
  * \param[in] rpc   RPC message to perform
  * \param[out] received_data    received data string, can be NULL when no data expected, value can be set to NULL if no data received
@@ -1449,7 +1618,7 @@ netconf_unlocked_op(struct nc_session *session, struct nc_rpc *rpc)
 static json_object *
 netconf_op(unsigned int session_key, struct nc_rpc *rpc, int strict, struct lyd_node **received_data)
 {
-    struct session_with_mutex * locked_session;
+    struct session_with_mutex *locked_session = NULL;
     struct nc_reply* reply = NULL;
     json_object *res = NULL;
     struct lyd_node *data = NULL;
@@ -1463,18 +1632,18 @@ netconf_op(unsigned int session_key, struct nc_rpc *rpc, int strict, struct lyd_
         goto finished;
     }
 
-    locked_session = session_get_locked(session_key, &res);
+    locked_session = session_get(session_key, &res);
     if (!locked_session) {
         ERROR("Unknown session or locking failed.");
         goto finished;
     }
 
-    session_user_activity(nc_session_get_username(locked_session->session));
+    /* send the request and get the reply, other requests may use the session meanwhile */
+    msgt = rpc_dispatcher_call(locked_session->dispatcher, rpc, 2000000, strict, &reply);
 
-    /* send the request and get the reply */
-    msgt = netconf_send_recv_timed(locked_session->session, rpc, 2000000, strict, &reply);
-
-    session_unlock(locked_session);
+    if (locked_session->config_cache && rpc_modifies_config(rpc)) {
+        config_cache_invalidate(locked_session->config_cache);
+    }
 
     res = netconf_test_reply(locked_session->session, session_key, msgt, reply, &data);
 
@@ -1488,18 +1657,89 @@ finished:
             data = NULL;
         }
     }
+    /* the reply is in the context of the session, keep the reference until it is freed */
+    if (locked_session) {
+        session_put(locked_session);
+    }
     return res;
 }
 
+/**
+ * \brief Print data received from the server as JSON annotated with the schema metadata.
+ *
+ * \param[in] data data to print
+ * \param[in] subtree whether to print only the children of the data node, see data_print_subtree()
+ * \param[in] since snapshot to print only the changes since as a patch, NULL to print all the data
+ * \param[in] cache metadata cache of the session, NULL if the session is gone
+ * \param[in] print_opts metadata options of the request, NULL for the full metadata
+ * \return Printed data to be freed by the caller, NULL on error.
+ */
 static char *
+data_print_json(const struct lyd_node *data, int subtree, const struct snapshot *since, struct metadata_cache *cache,
+                const struct data_print_opts *print_opts)
+{
+    struct json_writer writer;
+    struct data_print_opts opts;
+    const char *json;
+    char *data_json = NULL;
+
+    if (print_opts) {
+        opts = *print_opts;
+    } else {
+        memset(&opts, 0, sizeof opts);
+        opts.metadata = METADATA_FULL;
+    }
+    opts.cache = cache ? cache : metadata_cache_new();
+    if (!opts.cache) {
+        return NULL;
+    }
+
+    json_writer_init(&writer, 0);
+    if (since) {
+        data_print_diff(&writer, since->data, data, &opts);
+    } else if (subtree) {
+        data_print_subtree(&writer, data, &opts);
+    } else {
+        data_print(&writer, data, &opts);
+    }
+    json = json_writer_finish(&writer, NULL);
+    if (json) {
+        data_json = strdup(json);
+    }
+    if (!data_json) {
+        ERROR("Printing JSON data failed.");
+    }
+    json_writer_clean(&writer);
+    if (!cache) {
+        metadata_cache_free(opts.cache);
+    }
+    return data_json;
+}
+
+/**
+ * \brief Free received data held by a flight.
+ */
+static void
+data_tree_free(void *data)
+{
+    lyd_free_withsiblings(data);
+}
+
+/**
+ * \brief Release a cache entry held by a flight.
+ */
+static void
+config_entry_free_ref(void *entry)
+{
+    config_entry_put(entry);
+}
+
+static struct lyd_node *
 netconf_getconfig(unsigned int session_key, NC_DATASTORE source, const char *filter, int strict, json_object **err)
 {
     struct nc_rpc* rpc;
-    struct session_with_mutex *locked_session;
-    json_object *res = NULL, *data_cjson;
-    enum json_tokener_error tok_err;
-    char *data_json = NULL;
-    struct lyd_node *data, *sibling, *next;
+    json_object *res = NULL;
+    struct lyd_node *data;
 
     /* tell server to show all elements even if they have default values */
 #ifdef HAVE_WITHDEFAULTS_TAGGED
@@ -1520,43 +1760,7 @@ netconf_getconfig(unsigned int session_key, NC_DATASTORE source, const char *fil
         (*err) = NULL;
     }
 
-    if (data) {
-        for (locked_session = netconf_sessions_list;
-             locked_session && (locked_session->session_key != session_key);
-             locked_session = locked_session->next);
-        /* won't fail */
-
-        /* print data into JSON */
-        if (lyd_print_mem(&data_json, data, LYD_JSON, LYP_WITHSIBLINGS)) {
-            ERROR("Printing JSON <get-config> data failed.");
-            lyd_free_withsiblings(data);
-            return NULL;
-        }
-
-        /* parse JSON data into cjson */
-        pthread_mutex_lock(&json_lock);
-        data_cjson = json_tokener_parse_verbose(data_json, &tok_err);
-        if (!data_cjson) {
-            ERROR("Parsing JSON config failed (%s).", json_tokener_error_desc(tok_err));
-            pthread_mutex_unlock(&json_lock);
-            lyd_free_withsiblings(data);
-            free(data_json);
-            return NULL;
-        }
-        free(data_json);
-
-        /* go simultaneously through both trees and add metadata */
-        LY_TREE_FOR_SAFE(data, next, sibling) {
-            node_add_metadata_recursive(sibling, NULL, data_cjson);
-            lyd_free(sibling);
-        }
-
-        data_json = strdup(json_object_to_json_string_ext(data_cjson, 0));
-        json_object_put(data_cjson);
-        pthread_mutex_unlock(&json_lock);
-    }
-
-    return (data_json);
+    return (data);
 }
 
 static char *
@@ -1565,13 +1769,21 @@ netconf_getschema(unsigned int session_key, const char *identifier, const char *
     struct nc_rpc *rpc;
     struct lyd_node *data = NULL;
     struct lyd_node_anydata *adata;
+    struct session_with_mutex *session;
     json_object *res = NULL;
     char *model_data = NULL;
 
+    /* the received data are in the context of the session */
+    session = session_get(session_key, err);
+    if (!session) {
+        return NULL;
+    }
+
     /* create requests */
     rpc = nc_rpc_getschema(identifier, version, format, NC_PARAMTYPE_CONST);
     if (rpc == NULL) {
         ERROR("mod_netconf: creating rpc request failed");
+        session_put(session);
         return (NULL);
     }
 
@@ -1599,21 +1811,20 @@ netconf_getschema(unsigned int session_key, const char *identifier, const char *
             if (!model_data) {
                 ERROR("memory allocation fail (%s:%d)", __FILE__, __LINE__);
             }
+            lyd_free_withsiblings(data);
         }
     }
+    session_put(session);
 
     return (model_data);
 }
 
-static char *
+static struct lyd_node *
 netconf_get(unsigned int session_key, const char* filter, int strict, json_object **err)
 {
     struct nc_rpc* rpc;
-    char* data_json = NULL;
-    json_object *res = NULL, *data_cjson;
-    enum json_tokener_error tok_err;
-    struct session_with_mutex *locked_session;
-    struct lyd_node *data, *sibling, *next;
+    json_object *res = NULL;
+    struct lyd_node *data;
 
     /* create requests */
     rpc = nc_rpc_get(filter, 0, NC_PARAMTYPE_CONST);
@@ -1630,43 +1841,7 @@ netconf_get(unsigned int session_key, const char* filter, int strict, json_objec
         (*err) = NULL;
     }
 
-    if (data) {
-        for (locked_session = netconf_sessions_list;
-             locked_session && (locked_session->session_key != session_key);
-             locked_session = locked_session->next);
-        /* won't fail */
-
-        /* print JSON data */
-        if (lyd_print_mem(&data_json, data, LYD_JSON, LYP_WITHSIBLINGS)) {
-            ERROR("Printing JSON <get> data failed.");
-            lyd_free_withsiblings(data);
-            return NULL;
-        }
-
-        /* parse JSON data into cjson */
-        pthread_mutex_lock(&json_lock);
-        data_cjson = json_tokener_parse_verbose(data_json, &tok_err);
-        if (!data_cjson) {
-            ERROR("Parsing JSON config failed (%s).", json_tokener_error_desc(tok_err));
-            pthread_mutex_unlock(&json_lock);
-            lyd_free_withsiblings(data);
-            free(data_json);
-            return NULL;
-        }
-        free(data_json);
-
-        /* go simultaneously through both trees and add metadata */
-        LY_TREE_FOR_SAFE(data, next, sibling) {
-            node_add_metadata_recursive(sibling, NULL, data_cjson);
-            lyd_free(sibling);
-        }
-
-        data_json = strdup(json_object_to_json_string_ext(data_cjson, 0));
-        json_object_put(data_cjson);
-        pthread_mutex_unlock(&json_lock);
-    }
-
-    return data_json;
+    return data;
 }
 
 static json_object *
@@ -1792,36 +1967,12 @@ netconf_generic(unsigned int session_key, const char *xml_content, struct lyd_no
     return res;
 }
 
-static int
-node_add_metadata(const struct lys_node *node, const struct lys_module *module, json_object *parent)
+/**
+ * \brief Fill the metadata of a schema node into an object.
+ */
+static void
+node_metadata(const struct lys_node *node, json_object *meta_obj)
 {
-    struct lys_module *cur_module;
-    json_object *meta_obj;
-    char *obj_name;
-
-    if (node->nodetype == LYS_INPUT) {
-        /* silently skipped */
-        return 0;
-    }
-
-    cur_module = node->module;
-    if (cur_module->type) {
-        cur_module = ((struct lys_submodule *)cur_module)->belongsto;
-    }
-    if (cur_module == module) {
-        asprintf(&obj_name, "$@%s", node->name);
-    } else {
-        asprintf(&obj_name, "$@%s:%s", cur_module->name, node->name);
-    }
-
-    /* in (leaf-)lists the metadata could have already been added */
-    if ((node->nodetype & (LYS_LEAFLIST | LYS_LIST)) && (json_object_object_get_ex(parent, obj_name, NULL) == TRUE)) {
-        free(obj_name);
-        return 1;
-    }
-
-    meta_obj = json_object_new_object();
-
     switch (node->nodetype) {
         case LYS_CONTAINER:
             node_metadata_container((struct lys_node_container *)node, meta_obj);
@@ -1853,10 +2004,43 @@ node_add_metadata(const struct lys_node *node, const struct lys_module *module,
             ERROR("Internal: unuxpected nodetype (%s:%d)", __FILE__, __LINE__);
             break;
     }
+}
+
+static int
+node_add_metadata(const struct lys_node *node, const struct lys_module *module, json_object *parent)
+{
+    struct lys_module *cur_module;
+    json_object *meta_obj;
+    char *obj_name;
+
+    if (node->nodetype == LYS_INPUT) {
+        /* silently skipped */
+        return 0;
+    }
+
+    cur_module = node->module;
+    if (cur_module->type) {
+        cur_module = ((struct lys_submodule *)cur_module)->belongsto;
+    }
+    if (cur_module == module) {
+        asprintf(&obj_name, "$@%s", node->name);
+    } else {
+        asprintf(&obj_name, "$@%s:%s", cur_module->name, node->name);
+    }
+
+    /* in (leaf-)lists the metadata could have already been added */
+    if ((node->nodetype & (LYS_LEAFLIST | LYS_LIST)) && (json_object_object_get_ex(parent, obj_name, NULL) == TRUE)) {
+        free(obj_name);
+        return 1;
+    }
+
+    meta_obj = json_object_new_object();
+    node_metadata(node, meta_obj);
 
     /* just a precaution */
     if (json_object_get_type(parent) != json_type_object) {
         ERROR("Internal: wrong JSON type (%s:%d)", __FILE__, __LINE__);
+        json_object_put(meta_obj);
         free(obj_name);
         return 1;
     }
@@ -1866,83 +2050,96 @@ node_add_metadata(const struct lys_node *node, const struct lys_module *module,
     return 0;
 }
 
+/**
+ * \brief Fill the structural metadata of a data schema node into an object.
+ */
 static void
-node_add_metadata_recursive(struct lyd_node *data_tree, const struct lys_module *module, json_object *data_json_parent)
+node_metadata_minimal(const struct lys_node *node, json_object *meta_obj)
 {
-    struct lys_module *cur_module;
-    struct lys_node *list_schema;
-    struct lyd_node *child, *list_item;
-    json_object *child_json, *list_child_json;
-    char *child_name;
-    int list_idx;
-
-    if (data_tree->schema->nodetype & (LYS_OUTPUT | LYS_GROUPING)) {
-        return;
-    }
+    json_object *obj, *type_obj;
+    const struct lys_node_leaf *leaf;
+    const struct lys_node_list *list;
+    const char *eltype;
+    int i;
 
-    /* add data_tree metadata */
-    if (node_add_metadata(data_tree->schema, module, data_json_parent)) {
+    switch (node->nodetype) {
+    case LYS_CONTAINER:
+        eltype = "container";
+        break;
+    case LYS_LEAF:
+        eltype = "leaf";
+        break;
+    case LYS_LEAFLIST:
+        eltype = "leaf-list";
+        break;
+    case LYS_LIST:
+        eltype = "list";
+        break;
+    case LYS_ANYXML:
+        eltype = "anyxml";
+        break;
+    case LYS_ANYDATA:
+        eltype = "anydata";
+        break;
+    default:
+        /* not a data node, there is nothing structural */
+        node_metadata(node, meta_obj);
         return;
     }
+    json_object_object_add(meta_obj, "eltype", json_object_new_string(eltype));
+    json_object_object_add(meta_obj, "config", json_object_new_boolean(!(node->flags & LYS_CONFIG_R)));
 
-    /* get data_tree module */
-    cur_module = data_tree->schema->module;
-    if (cur_module->type) {
-        cur_module = ((struct lys_submodule *)cur_module)->belongsto;
+    if (node->nodetype & (LYS_LEAF | LYS_LEAFLIST)) {
+        /* just the name of the type, the typedef chain is omitted */
+        leaf = (const struct lys_node_leaf *)node;
+        type_obj = json_object_new_object();
+        node_metadata_type((struct lys_type *)&leaf->type, leaf->module, type_obj);
+        if (json_object_object_get_ex(type_obj, "type", &obj)) {
+            json_object_object_add(meta_obj, "type", json_object_get(obj));
+        }
+        json_object_put(type_obj);
     }
 
-    if (!(data_tree->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYXML))) {
-        /* print correct data_tree JSON name */
-        if (cur_module == module) {
-            asprintf(&child_name, "%s", data_tree->schema->name);
+    if (node->nodetype == LYS_LEAF) {
+        list = (const struct lys_node_list *)lys_parent(node);
+        if (list && (list->nodetype == LYS_LIST)) {
+            for (i = 0; (i < list->keys_size) && (list->keys[i] != (struct lys_node_leaf *)node); ++i);
+            json_object_object_add(meta_obj, "iskey", json_object_new_boolean(i < list->keys_size));
         } else {
-            asprintf(&child_name, "%s:%s", cur_module->name, data_tree->schema->name);
+            json_object_object_add(meta_obj, "iskey", json_object_new_boolean(0));
         }
-
-        /* go down in JSON object */
-        if (json_object_object_get_ex(data_json_parent, child_name, &child_json) == FALSE) {
-            ERROR("Internal: failed to get JSON object \"%s\".", child_name);
-            free(child_name);
-            return;
+    } else if ((node->nodetype == LYS_LIST) && ((const struct lys_node_list *)node)->keys_size) {
+        list = (const struct lys_node_list *)node;
+        obj = json_object_new_array();
+        for (i = 0; i < list->keys_size; ++i) {
+            json_object_array_add(obj, json_object_new_string(list->keys[i]->name));
         }
-        free(child_name);
+        json_object_object_add(meta_obj, "keys", obj);
+    }
+}
 
-        if (data_tree->schema->nodetype == LYS_LIST) {
-            if (json_object_get_type(child_json) != json_type_array) {
-                ERROR("Internal: type mismatch (%s:%d)", __FILE__, __LINE__);
-                return;
-            }
-            /* go down in data tree for every item, we process them all now, skip later
-             * (metadata duplicate will be detected at the beginning of this function) */
-            list_idx = 0;
-            list_schema = data_tree->schema;
-
-            LY_TREE_FOR(data_tree, list_item) {
-                /* another list member */
-                if (list_item->schema == list_schema) {
-                    list_child_json = json_object_array_get_idx(child_json, list_idx);
-                    if (!list_child_json) {
-                        ERROR("Internal: list \"%s\" idx out-of-bounds", list_schema->name);
-                        return;
-                    }
-                    LY_TREE_FOR(list_item->child, child) {
-                        node_add_metadata_recursive(child, cur_module, list_child_json);
-                    }
+char *
+node_metadata_json(const struct lys_node *node, int minimal, size_t *len)
+{
+    json_object *meta_obj;
+    const char *str;
+    char *json = NULL;
 
-                    ++list_idx;
-                }
-            }
-        } else {
-            if (json_object_get_type(child_json) != json_type_object) {
-                ERROR("Internal: type mismatch (%s:%d)", __FILE__, __LINE__);
-                return;
-            }
-            /* go down in data tree */
-            LY_TREE_FOR(data_tree->child, child) {
-                node_add_metadata_recursive(child, cur_module, child_json);
-            }
-        }
+    meta_obj = json_object_new_object();
+    if (minimal) {
+        node_metadata_minimal(node, meta_obj);
+    } else {
+        node_metadata(node, meta_obj);
+    }
+    str = json_object_to_json_string_length(meta_obj, JSON_C_TO_STRING_PLAIN, len);
+    if (str) {
+        json = strdup(str);
     }
+    if (!json) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+    }
+    json_object_put(meta_obj);
+    return json;
 }
 
 static void
@@ -2027,8 +2224,6 @@ libyang_query(unsigned int session_key, json_object *filter_array, int load_chil
         goto finish;
     }
 
-    session_user_activity(nc_session_get_username(locked_session->session));
-
     for (i = 0; i < json_object_array_length(filter_array); ++i) {
         obj = json_object_array_get_idx(filter_array, i);
         filter = json_object_get_string(obj);
@@ -2047,7 +2242,6 @@ libyang_query(unsigned int session_key, json_object *filter_array, int load_chil
             }
         }
 
-        pthread_mutex_lock(&json_lock);
         if (!data) {
             data = json_object_new_object();
         }
@@ -2067,7 +2261,6 @@ libyang_query(unsigned int session_key, json_object *filter_array, int load_chil
             }
         }
 
-        pthread_mutex_unlock(&json_lock);
     }
 
     ret = create_data_reply(json_object_to_json_string(data));
@@ -2076,17 +2269,19 @@ libyang_query(unsigned int session_key, json_object *filter_array, int load_chil
 
 finish:
     json_object_put(data);
-    session_unlock(locked_session);
+    if (locked_session) {
+        session_unlock(locked_session);
+    }
     return ret;
 }
 
 static json_object *
-libyang_merge(unsigned int session_key, const char *config)
+libyang_merge(unsigned int session_key, const char *config, const struct data_print_opts *print_opts)
 {
-    struct lyd_node *data_tree = NULL, *sibling;
+    struct lyd_node *data_tree = NULL;
     struct session_with_mutex *locked_session;
-    json_object *ret = NULL, *data_json = NULL;
-    enum json_tokener_error err = 0;
+    json_object *ret = NULL;
+    char *data_json;
 
     locked_session = session_get_locked(session_key, &ret);
     if (!locked_session) {
@@ -2094,39 +2289,32 @@ libyang_merge(unsigned int session_key, const char *config)
         goto finish;
     }
 
-    session_user_activity(nc_session_get_username(locked_session->session));
-
     data_tree = lyd_parse_mem(nc_session_get_ctx(locked_session->session), config, LYD_JSON, LYD_OPT_DATA | LYD_OPT_STRICT);
     if (!data_tree) {
         ERROR("Creating data tree failed.");
         ret = create_error_reply("Failed to create data tree from JSON config.");
         session_unlock(locked_session);
+        locked_session = NULL;
         goto finish;
     }
 
-    session_unlock(locked_session);
+    /* the metadata cache is used unlocked, the reference keeps it */
+    DEBUG("UNLOCK mutex %s", __func__);
+    pthread_mutex_unlock(&locked_session->lock);
 
-    pthread_mutex_lock(&json_lock);
-    data_json = json_tokener_parse_verbose(config, &err);
+    data_json = data_print_json(data_tree, 0, NULL, locked_session->metadata_cache, print_opts);
     if (!data_json) {
-        ERROR("Parsing JSON config failed (%s).", json_tokener_error_desc(err));
-        pthread_mutex_unlock(&json_lock);
-        ret = create_error_reply(json_tokener_error_desc(err));
+        ret = create_error_reply("Failed to print the merged config.");
         goto finish;
     }
-
-    /* go simultaneously through both trees and add metadata */
-    LY_TREE_FOR(data_tree, sibling) {
-        node_add_metadata_recursive(sibling, NULL, data_json);
-    }
-    pthread_mutex_unlock(&json_lock);
-    ret = create_data_reply(json_object_to_json_string(data_json));
+    ret = create_data_reply(data_json);
+    free(data_json);
 
 finish:
-    LY_TREE_FOR(data_tree, sibling) {
-        lyd_free(sibling);
+    lyd_free_withsiblings(data_tree);
+    if (locked_session) {
+        session_put(locked_session);
     }
-    json_object_put(data_json);
     return ret;
 }
 
@@ -2159,88 +2347,80 @@ clb_print(NC_VERB_LEVEL level, const char *msg)
 }
 
 /**
- * Receive message from client over UNIX socket and return pointer to it.
- * Caller should free message memory.
- * \param[in] client    socket descriptor of client
- * \return pointer to message
+ * \brief Send a message to the frontend in chunked framing.
+ *
+ * The chunk header, the message and the end-of-chunks are written with
+ * writev() straight from their buffers, the message is never copied. Partial
+ * writes are resumed and a non-blocking socket is waited on until writable.
+ *
+ * \param[in] fd   client socket
+ * \param[in] msg  message to send
+ * \param[in] len  length of msg
+ * \return 0 on success, -1 on error.
  */
-char *
-get_framed_message(int client)
+int
+send_framed_message(int fd, const char *msg, size_t len)
 {
-    /* read json in chunked framing */
-    unsigned int buffer_size = 0;
-    ssize_t buffer_len = 0;
-    char *buffer = NULL;
-    char c;
-    ssize_t ret;
-    int i, chunk_len;
-    char chunk_len_str[12];
-
-    while (1) {
-        /* read chunk length */
-        if ((ret = recv (client, &c, 1, 0)) != 1 || c != '\n') {
-            if (buffer != NULL) {
-                free (buffer);
-                buffer = NULL;
-            }
-            break;
-        }
-        if ((ret = recv (client, &c, 1, 0)) != 1 || c != '#') {
-            if (buffer != NULL) {
-                free (buffer);
-                buffer = NULL;
-            }
-            break;
-        }
-        i=0;
-        memset (chunk_len_str, 0, 12);
-        while ((ret = recv (client, &c, 1, 0) == 1 && (isdigit(c) || c == '#'))) {
-            if (i==0 && c == '#') {
-                if (recv (client, &c, 1, 0) != 1 || c != '\n') {
-                    /* end but invalid */
-                    if (buffer != NULL) {
-                        free (buffer);
-                        buffer = NULL;
-                    }
+    /* the terminating zero is sent as well, frontends expect it */
+    static const char trailer[] = "\n##\n";
+    char header[24];
+    struct iovec iov[3], *cur;
+    struct pollfd pfd;
+    int iovcnt, ret;
+    ssize_t sent;
+
+    if (!len) {
+        ERROR("Empty message cannot be sent in chunked framing.");
+        return -1;
+    }
+
+    iov[0].iov_base = header;
+    iov[0].iov_len = sprintf(header, "\n#%zu\n", len);
+    iov[1].iov_base = (void *)msg;
+    iov[1].iov_len = len;
+    iov[2].iov_base = (void *)trailer;
+    iov[2].iov_len = sizeof trailer;
+    cur = iov;
+    iovcnt = 3;
+
+    while (iovcnt) {
+        sent = writev(fd, cur, iovcnt);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                pfd.fd = fd;
+                pfd.events = POLLOUT;
+                pfd.revents = 0;
+                ret = poll(&pfd, 1, SEND_TIMEOUT);
+                if ((ret == -1) && (errno == EINTR)) {
+                    continue;
+                } else if (ret < 1) {
+                    ERROR("Sending message failed (%s).", ret ? strerror(errno) : "timeout");
+                    return -1;
+                } else if (pfd.revents & (POLLERR | POLLHUP)) {
+                    ERROR("Sending message failed (connection closed).");
+                    return -1;
                 }
-                /* end of message, double-loop break */
-                goto msg_complete;
-            }
-            chunk_len_str[i++] = c;
-            if (i==11) {
-                ERROR("Message is too long, buffer for length is not big enought!!!!");
-                break;
-            }
-        }
-        if (c != '\n') {
-            if (buffer != NULL) {
-                free (buffer);
-                buffer = NULL;
+                continue;
             }
-            break;
+            ERROR("Sending message failed (%s).", strerror(errno));
+            return -1;
         }
-        chunk_len_str[i] = 0;
-        if ((chunk_len = atoi (chunk_len_str)) == 0) {
-            if (buffer != NULL) {
-                free (buffer);
-                buffer = NULL;
-            }
-            break;
+
+        /* skip what was written */
+        while (iovcnt && ((size_t)sent >= cur->iov_len)) {
+            sent -= cur->iov_len;
+            ++cur;
+            --iovcnt;
         }
-        buffer_size += chunk_len+1;
-        buffer = realloc (buffer, sizeof(char)*buffer_size);
-        memset(buffer + (buffer_size-chunk_len-1), 0, chunk_len+1);
-        if ((ret = recv (client, buffer+buffer_len, chunk_len, 0)) == -1 || ret != chunk_len) {
-            if (buffer != NULL) {
-                free (buffer);
-                buffer = NULL;
-            }
-            break;
+        if (iovcnt) {
+            cur->iov_base = (char *)cur->iov_base + sent;
+            cur->iov_len -= sent;
         }
-        buffer_len += ret;
     }
-msg_complete:
-    return buffer;
+
+    return 0;
 }
 
 NC_DATASTORE
@@ -2282,37 +2462,103 @@ create_error_reply(const char *errmess)
 
     ERROR(errmess);
 
-    pthread_mutex_lock(&json_lock);
     reply = json_object_new_object();
     array = json_object_new_array();
     json_object_object_add(reply, "type", json_object_new_int(REPLY_ERROR));
     json_object_array_add(array, json_object_new_string(errmess));
     json_object_object_add(reply, "errors", array);
-    pthread_mutex_unlock(&json_lock);
 
     return reply;
 }
 
-json_object *
-create_data_reply(const char *data)
+/**
+ * \brief Create DATA reply with data that are not JSON (e.g. a YANG schema).
+ */
+static json_object *
+create_text_data_reply(const char *data)
 {
-    pthread_mutex_lock(&json_lock);
     json_object *reply = json_object_new_object();
     json_object_object_add(reply, "type", json_object_new_int(REPLY_DATA));
     json_object_object_add(reply, "data", json_object_new_string(data));
-    pthread_mutex_unlock(&json_lock);
     return reply;
 }
 
+/**
+ * \brief Create DATA reply with JSON data, they can be embedded in the reply as a native JSON value.
+ */
+json_object *
+create_data_reply(const char *data)
+{
+    json_object *reply, *data_json;
+
+    reply = create_text_data_reply(data);
+    json_object_object_get_ex(reply, "data", &data_json);
+    json_object_set_userdata(data_json, (void *)&data_is_json, NULL);
+    return reply;
+}
+
+/**
+ * \brief Create DATA reply with the changes of JSON data since a snapshot.
+ */
+static json_object *
+create_patch_reply(const char *patch)
+{
+    json_object *reply, *patch_json;
+
+    reply = json_object_new_object();
+    json_object_object_add(reply, "type", json_object_new_int(REPLY_DATA));
+    patch_json = json_object_new_string(patch);
+    json_object_set_userdata(patch_json, (void *)&data_is_json, NULL);
+    json_object_object_add(reply, "patch", patch_json);
+    return reply;
+}
+
+/**
+ * \brief Write a single reply.
+ *
+ * The members of the reply are written one by one, so the data (or the patch)
+ * of a DATA reply are escaped straight from their json-c string into the output,
+ * json-c does not serialize them into a buffer of its own first. In the raw mode,
+ * data that are JSON text are written as they are, as a native JSON value.
+ * A string marked as JSON text in place of a reply (the schema dictionary) is
+ * always written as it is.
+ *
+ * \param[in] writer output writer
+ * \param[in] reply reply to write
+ * \param[in] raw whether to embed JSON data as a native JSON value
+ */
+static void
+write_reply(struct json_writer *writer, json_object *reply, int raw)
+{
+    if (json_object_is_type(reply, json_type_string) && (json_object_get_userdata(reply) == &data_is_json)) {
+        json_writer_raw(writer, json_object_get_string(reply), json_object_get_string_len(reply));
+        return;
+    } else if (!json_object_is_type(reply, json_type_object)) {
+        json_writer_object(writer, reply);
+        return;
+    }
+
+    json_writer_object_start(writer);
+    json_object_object_foreach(reply, key, val) {
+        json_writer_key(writer, key);
+        if (!json_object_is_type(val, json_type_string)) {
+            json_writer_object(writer, val);
+        } else if (raw && (json_object_get_userdata(val) == &data_is_json) && json_object_get_string_len(val)) {
+            json_writer_raw(writer, json_object_get_string(val), json_object_get_string_len(val));
+        } else {
+            json_writer_string_len(writer, json_object_get_string(val), json_object_get_string_len(val));
+        }
+    }
+    json_writer_object_end(writer);
+}
+
 json_object *
 create_ok_reply(void)
 {
     json_object *reply;
 
-    pthread_mutex_lock(&json_lock);
     reply = json_object_new_object();
     json_object_object_add(reply, "type", json_object_new_int(REPLY_OK));
-    pthread_mutex_unlock(&json_lock);
     return reply;
 }
 
@@ -2321,9 +2567,7 @@ create_replies(void)
 {
     json_object *replies;
 
-    pthread_mutex_lock(&json_lock);
     replies = json_object_new_object();
-    pthread_mutex_unlock(&json_lock);
 
     return replies;
 }
@@ -2335,9 +2579,7 @@ add_reply(json_object *replies, json_object *reply, unsigned int session_key)
 
     asprintf(&str, "%u", session_key);
 
-    pthread_mutex_lock(&json_lock);
     json_object_object_add(replies, str, reply);
-    pthread_mutex_unlock(&json_lock);
 
     free(str);
 }
@@ -2365,7 +2607,6 @@ handle_op_connect(json_object *request)
     unsigned int session_key = 0;
 
     DEBUG("Request: connect");
-    pthread_mutex_lock(&json_lock);
 
     host = get_param_string(request, "host");
     port = get_param_string(request, "port");
@@ -2373,8 +2614,6 @@ handle_op_connect(json_object *request)
     pass = get_param_string(request, "pass");
     privkey = get_param_string(request, "privatekey");
 
-    pthread_mutex_unlock(&json_lock);
-
     if (host == NULL) {
         host = "localhost";
     }
@@ -2390,7 +2629,6 @@ handle_op_connect(json_object *request)
 
     GETSPEC_ERR_REPLY
 
-    pthread_mutex_lock(&json_lock);
     if (session_key == 0) {
         /* negative reply */
         if (err_reply == NULL) {
@@ -2410,7 +2648,6 @@ handle_op_connect(json_object *request)
         json_object_object_add(reply, "session", json_object_new_int(session_key));
     }
     memset(pass, 0, strlen(pass));
-    pthread_mutex_unlock(&json_lock);
     CHECK_AND_FREE(host);
     CHECK_AND_FREE(user);
     CHECK_AND_FREE(port);
@@ -2435,32 +2672,203 @@ handle_op_disconnect(json_object *UNUSED(request), unsigned int session_key)
     return reply;
 }
 
+/**
+ * \brief Create a DATA reply with received data, or with their changes since the snapshot the request refers to.
+ *
+ * With "snapshot": true or "since": token in the request, a copy of the data is kept and its token
+ * is returned in the reply. The snapshot referred to by "since" is superseded by the new one.
+ *
+ * \param[in] request request
+ * \param[in] session referenced session
+ * \param[in] operation operation of the request
+ * \param[in] source datastore of get-config
+ * \param[in] filter subtree filter, can be NULL
+ * \param[in] data received data
+ * \param[in] version version of the data, can be NULL
+ * \param[in] print_opts metadata options of the request
+ * \return DATA reply, NULL on error.
+ */
+static json_object *
+create_tree_reply(json_object *request, struct session_with_mutex *session, int operation, NC_DATASTORE source,
+                  const char *filter, const struct lyd_node *data, const char *version,
+                  const struct data_print_opts *print_opts)
+{
+    struct snapshot_store *snapshots = NULL;
+    struct snapshot *since = NULL;
+    json_object *reply, *obj, *since_token = NULL;
+    char token[SNAPSHOT_TOKEN_SIZE];
+    char *data_json;
+
+    json_object_object_get_ex(request, "since", &since_token);
+    if (since_token || (json_object_object_get_ex(request, "snapshot", &obj) && json_object_get_boolean(obj))) {
+        snapshots = session->snapshots;
+    }
+    if (snapshots && since_token) {
+        since = snapshot_get(snapshots, json_object_get_string(since_token), operation, source, filter);
+        if (!since) {
+            DEBUG("Snapshot %s of session %u not found, sending all the data.", json_object_get_string(since_token),
+                  session->session_key);
+        }
+    }
+
+    if ((data_json = data_print_json(data, 0, since, session->metadata_cache, print_opts)) == NULL) {
+        reply = NULL;
+        goto cleanup;
+    }
+    reply = since ? create_patch_reply(data_json) : create_data_reply(data_json);
+    free(data_json);
+
+    if (version) {
+        json_object_object_add(reply, "version", json_object_new_string(version));
+    }
+    if (snapshots && !snapshot_add(snapshots, operation, source, filter, data, since, token)) {
+        json_object_object_add(reply, "snapshot", json_object_new_string(token));
+    }
+
+cleanup:
+    if (since) {
+        snapshot_put(since);
+    }
+    return reply;
+}
+
+/**
+ * \brief Get data of a session and create the reply.
+ *
+ * The data are taken from the cache of the session if possible, otherwise they are
+ * retrieved from the server, once for all the identical requests in progress.
+ * Results of get-config are always cached, results of get only for the requests
+ * paging their lists or limiting the depth, to have the rest of the data at hand.
+ *
+ * \param[in] request request
+ * \param[in] session_key session identifier
+ * \param[in] operation MSG_GET or MSG_GETCONFIG
+ * \param[in] source datastore of get-config
+ * \param[in] filter subtree filter, can be NULL
+ * \param[in] strict whether to parse the data strictly
+ * \param[in] print_opts metadata options of the request
+ * \return Reply.
+ */
+static json_object *
+get_data(json_object *request, unsigned int session_key, int operation, NC_DATASTORE source, const char *filter,
+         int strict, const struct data_print_opts *print_opts)
+{
+    const char *name = (operation == MSG_GET) ? "get" : "get-config";
+    const char *errmsg = (operation == MSG_GET) ? "Get information failed." : "Get configuration operation failed.";
+    json_object *reply = NULL, *obj;
+    struct session_with_mutex *session;
+    struct config_cache *cache = NULL;
+    struct config_entry *entry = NULL;
+    struct flight *flight = NULL;
+    const struct lyd_node *tree;
+    struct lyd_node *received;
+    const char *version = NULL;
+    uint64_t generation = 0;
+    int leader;
+
+    /* the caches of the session are used unlocked, the reference keeps them */
+    session = session_get(session_key, &reply);
+    if (!session) {
+        return reply;
+    }
+
+    if (((operation == MSG_GETCONFIG) || (print_opts && (print_opts->page_count || print_opts->depth)))
+            && (!json_object_object_get_ex(request, "cache", &obj) || json_object_get_boolean(obj))) {
+        cache = session->config_cache;
+    }
+    if (cache) {
+        entry = config_cache_get(cache, operation, source, filter, strict);
+        if (entry && json_object_object_get_ex(request, "if-none-match", &obj)
+                && !strcmp(json_object_get_string(obj), entry->version)) {
+            DEBUG("%s data of session %u unchanged (version %s)", name, session_key, entry->version);
+            reply = create_ok_reply();
+            json_object_object_add(reply, "unchanged", json_object_new_boolean(TRUE));
+            json_object_object_add(reply, "version", json_object_new_string(entry->version));
+            goto finalize;
+        }
+    }
+
+    if (entry) {
+        tree = entry->data;
+        version = entry->version;
+    } else {
+        flight = flight_join(session->flights, (operation == MSG_GET) ? FLIGHT_GET : FLIGHT_GETCONFIG,
+                             source, filter, strict, &leader);
+        if (!flight) {
+            reply = create_error_reply("Memory allocation failed.");
+            goto finalize;
+        }
+        if (leader) {
+            /* the data are cached only if they were not changed while being retrieved */
+            if (cache) {
+                generation = config_cache_generation(cache);
+            }
+            if (operation == MSG_GET) {
+                received = netconf_get(session_key, filter, strict, &reply);
+            } else {
+                received = netconf_getconfig(session_key, source, filter, strict, &reply);
+            }
+            if (received == NULL) {
+                CHECK_ERR_SET_REPLY_ERR(errmsg)
+                flight_land(flight, NULL, NULL, NULL, NULL, reply);
+                goto finalize;
+            }
+            if (!cache) {
+                flight_land(flight, received, NULL, received, data_tree_free, NULL);
+            } else if ((entry = config_cache_put(cache, operation, source, filter, strict, received, generation)) == NULL) {
+                reply = create_error_reply("Memory allocation failed.");
+                flight_land(flight, NULL, NULL, NULL, NULL, reply);
+                goto finalize;
+            } else {
+                /* the reference is held by the flight now */
+                flight_land(flight, entry->data, entry->version, entry, config_entry_free_ref, NULL);
+                entry = NULL;
+            }
+        } else {
+            DEBUG("%s of session %u joined an identical request in progress", name, session_key);
+            flight_wait(flight);
+            if (!flight->data) {
+                reply = flight_error(flight);
+                goto finalize;
+            }
+        }
+        tree = flight->data;
+        version = flight->version;
+    }
+
+    reply = create_tree_reply(request, session, operation, source, filter, tree, version, print_opts);
+    if (reply == NULL) {
+        CHECK_ERR_SET_REPLY_ERR(errmsg)
+    }
+
+finalize:
+    if (entry) {
+        config_entry_put(entry);
+    }
+    if (flight) {
+        flight_leave(flight);
+    }
+    session_put(session);
+    return reply;
+}
+
 json_object *
-handle_op_get(json_object *request, unsigned int session_key)
+handle_op_get(json_object *request, unsigned int session_key, const struct data_print_opts *print_opts)
 {
     char *filter = NULL;
-    char *data = NULL;
     json_object *reply = NULL, *obj;
     int strict;
 
     DEBUG("Request: get (session %u)", session_key);
 
-    pthread_mutex_lock(&json_lock);
     filter = get_param_string(request, "filter");
     if (json_object_object_get_ex(request, "strict", &obj) == FALSE) {
-        pthread_mutex_unlock(&json_lock);
         reply = create_error_reply("Missing strict parameter.");
         goto finalize;
     }
     strict = json_object_get_boolean(obj);
-    pthread_mutex_unlock(&json_lock);
 
-    if ((data = netconf_get(session_key, filter, strict, &reply)) == NULL) {
-        CHECK_ERR_SET_REPLY_ERR("Get information failed.")
-    } else {
-        reply = create_data_reply(data);
-        free(data);
-    }
+    reply = get_data(request, session_key, MSG_GET, 0, filter, strict, print_opts);
 
 finalize:
     CHECK_AND_FREE(filter);
@@ -2468,42 +2876,33 @@ finalize:
 }
 
 json_object *
-handle_op_getconfig(json_object *request, unsigned int session_key)
+handle_op_getconfig(json_object *request, unsigned int session_key, const struct data_print_opts *print_opts)
 {
     NC_DATASTORE ds_type_s = -1;
     char *filter = NULL;
-    char *data = NULL;
     char *source = NULL;
     json_object *reply = NULL, *obj;
     int strict;
 
     DEBUG("Request: get-config (session %u)", session_key);
 
-    pthread_mutex_lock(&json_lock);
     filter = get_param_string(request, "filter");
     source = get_param_string(request, "source");
     if (source != NULL) {
         ds_type_s = parse_datastore(source);
     }
     if (json_object_object_get_ex(request, "strict", &obj) == FALSE) {
-        pthread_mutex_unlock(&json_lock);
         reply = create_error_reply("Missing strict parameter.");
         goto finalize;
     }
     strict = json_object_get_boolean(obj);
-    pthread_mutex_unlock(&json_lock);
 
     if ((int)ds_type_s == -1) {
         reply = create_error_reply("Invalid source repository type requested.");
         goto finalize;
     }
 
-    if ((data = netconf_getconfig(session_key, ds_type_s, filter, strict, &reply)) == NULL) {
-        CHECK_ERR_SET_REPLY_ERR("Get configuration operation failed.")
-    } else {
-        reply = create_data_reply(data);
-        free(data);
-    }
+    reply = get_data(request, session_key, MSG_GETCONFIG, ds_type_s, filter, strict, print_opts);
 
 finalize:
     CHECK_AND_FREE(filter);
@@ -2511,6 +2910,70 @@ finalize:
     return reply;
 }
 
+json_object *
+handle_op_expand(json_object *request, unsigned int session_key, const struct data_print_opts *print_opts)
+{
+    char *version = NULL, *path = NULL, *data;
+    json_object *reply = NULL;
+    struct session_with_mutex *session = NULL;
+    struct config_entry *entry = NULL;
+    struct ly_set *set = NULL;
+    const struct lyd_node *node;
+
+    DEBUG("Request: expand (session %u)", session_key);
+
+    version = get_param_string(request, "version");
+    path = get_param_string(request, "path");
+    if (!version || !path) {
+        reply = create_error_reply("Missing version or path parameter.");
+        goto finalize;
+    }
+
+    session = session_get(session_key, &reply);
+    if (!session) {
+        goto finalize;
+    }
+    if (session->config_cache) {
+        entry = config_cache_find(session->config_cache, version);
+    }
+    if (!entry) {
+        reply = create_error_reply("The data are not cached anymore, get them again.");
+        goto finalize;
+    }
+
+    /* the data are only read, the cache entry keeps them */
+    set = entry->data ? lyd_find_path(entry->data, path) : NULL;
+    if (!set || (set->number != 1)) {
+        reply = create_error_reply("The path does not identify a single node of the data.");
+        goto finalize;
+    }
+    node = set->set.d[0];
+    if (!(node->schema->nodetype & (LYS_CONTAINER | LYS_LIST))) {
+        reply = create_error_reply("Only a container or a list instance can be expanded.");
+        goto finalize;
+    }
+
+    if ((data = data_print_json(node, 1, NULL, session->metadata_cache, print_opts)) == NULL) {
+        reply = create_error_reply("Printing the data failed.");
+        goto finalize;
+    }
+    reply = create_data_reply(data);
+    json_object_object_add(reply, "version", json_object_new_string(entry->version));
+    free(data);
+
+finalize:
+    ly_set_free(set);
+    if (entry) {
+        config_entry_put(entry);
+    }
+    if (session) {
+        session_put(session);
+    }
+    CHECK_AND_FREE(version);
+    CHECK_AND_FREE(path);
+    return reply;
+}
+
 json_object *
 handle_op_editconfig(json_object *request, unsigned int session_key, int idx)
 {
@@ -2530,10 +2993,8 @@ handle_op_editconfig(json_object *request, unsigned int session_key, int idx)
 
     DEBUG("Request: edit-config (session %u)", session_key);
 
-    pthread_mutex_lock(&json_lock);
     /* get parameters */
     if (json_object_object_get_ex(request, "configs", &configs) == FALSE) {
-        pthread_mutex_unlock(&json_lock);
         reply = create_error_reply("Missing configs parameter.");
         goto finalize;
     }
@@ -2545,7 +3006,6 @@ handle_op_editconfig(json_object *request, unsigned int session_key, int idx)
     erropt = get_param_string(request, "error-option");
     urisource = get_param_string(request, "uri-source");
     testopt = get_param_string(request, "test-option");
-    pthread_mutex_unlock(&json_lock);
 
     if (!target) {
         reply = create_error_reply("Missing the target parameter.");
@@ -2596,9 +3056,12 @@ handle_op_editconfig(json_object *request, unsigned int session_key, int idx)
         }
 
         content = lyd_parse_mem(nc_session_get_ctx(locked_session->session), config, LYD_JSON, LYD_OPT_EDIT);
-        session_unlock(locked_session);
+        /* the content is in the context of the session, keep the reference until it is freed */
+        DEBUG("UNLOCK mutex %s", __func__);
+        pthread_mutex_unlock(&locked_session->lock);
 
         if (!content) {
+            session_put(locked_session);
         	reply = create_error_reply("Failed to parse edit-config content.");
             goto finalize;
         }
@@ -2608,6 +3071,7 @@ handle_op_editconfig(json_object *request, unsigned int session_key, int idx)
 
         lyd_print_mem(&config, content, LYD_XML, LYP_WITHSIBLINGS);
         lyd_free_withsiblings(content);
+        session_put(locked_session);
         if (!config) {
         	reply = create_error_reply("Failed to print edit-config content.");
             goto finalize;
@@ -2652,26 +3116,22 @@ handle_op_copyconfig(json_object *request, unsigned int session_key, int idx)
     DEBUG("Request: copy-config (session %u)", session_key);
 
     /* get parameters */
-    pthread_mutex_lock(&json_lock);
     target = get_param_string(request, "target");
     source = get_param_string(request, "source");
     uri_src = get_param_string(request, "uri-source");
     uri_trg = get_param_string(request, "uri-target");
     if (!strcmp(source, "config")) {
         if (json_object_object_get_ex(request, "configs", &configs) == FALSE) {
-            pthread_mutex_unlock(&json_lock);
             reply = create_error_reply("Missing configs parameter.");
             goto finalize;
         }
         obj = json_object_array_get_idx(configs, idx);
         if (!obj) {
-            pthread_mutex_unlock(&json_lock);
             reply = create_error_reply("Configs array parameter shorter than sessions.");
             goto finalize;
         }
         config = strdup(json_object_get_string(obj));
     }
-    pthread_mutex_unlock(&json_lock);
 
     if (target != NULL) {
         ds_type_t = parse_datastore(target);
@@ -2711,11 +3171,14 @@ handle_op_copyconfig(json_object *request, unsigned int session_key, int idx)
         }
 
         content = lyd_parse_mem(nc_session_get_ctx(locked_session->session), config, LYD_JSON, LYD_OPT_CONFIG);
-        session_unlock(locked_session);
+        /* the content is in the context of the session, keep the reference until it is freed */
+        DEBUG("UNLOCK mutex %s", __func__);
+        pthread_mutex_unlock(&locked_session->lock);
 
         free(config);
         lyd_print_mem(&config, content, LYD_XML, LYP_WITHSIBLINGS);
         lyd_free_withsiblings(content);
+        session_put(locked_session);
     }
 
     reply = netconf_copyconfig(session_key, ds_type_s, ds_type_t, config, uri_src, uri_trg);
@@ -2741,10 +3204,8 @@ handle_op_deleteconfig(json_object *request, unsigned int session_key)
 
     DEBUG("Request: delete-config (session %u)", session_key);
 
-    pthread_mutex_lock(&json_lock);
     target = get_param_string(request, "target");
     url = get_param_string(request, "url");
-    pthread_mutex_unlock(&json_lock);
 
     if (target != NULL) {
         ds_type = parse_datastore(target);
@@ -2781,9 +3242,7 @@ handle_op_lock(json_object *request, unsigned int session_key)
 
     DEBUG("Request: lock (session %u)", session_key);
 
-    pthread_mutex_lock(&json_lock);
     target = get_param_string(request, "target");
-    pthread_mutex_unlock(&json_lock);
 
     if (target != NULL) {
         ds_type = parse_datastore(target);
@@ -2814,9 +3273,7 @@ handle_op_unlock(json_object *request, unsigned int session_key)
 
     DEBUG("Request: unlock (session %u)", session_key);
 
-    pthread_mutex_lock(&json_lock);
     target = get_param_string(request, "target");
-    pthread_mutex_unlock(&json_lock);
 
     if (target != NULL) {
         ds_type = parse_datastore(target);
@@ -2846,9 +3303,7 @@ handle_op_kill(json_object *request, unsigned int session_key)
 
     DEBUG("Request: kill-session (session %u)", session_key);
 
-    pthread_mutex_lock(&json_lock);
     sid = get_param_string(request, "session-id");
-    pthread_mutex_unlock(&json_lock);
 
     if (sid == NULL) {
         reply = create_error_reply("Missing session-id parameter.");
@@ -2871,34 +3326,15 @@ handle_op_info(json_object *UNUSED(request), unsigned int session_key)
     struct session_with_mutex *locked_session = NULL;
     DEBUG("Request: get info about session %u", session_key);
 
-    DEBUG("LOCK wrlock %s", __func__);
-    if (pthread_rwlock_rdlock(&session_lock) != 0) {
-        ERROR("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-        return create_error_reply("Internal error");
-    }
-
-    for (locked_session = netconf_sessions_list;
-         locked_session && (locked_session->session_key != session_key);
-         locked_session = locked_session->next);
+    locked_session = session_get_locked(session_key, NULL);
     if (locked_session != NULL) {
-        DEBUG("LOCK mutex %s", __func__);
-        pthread_mutex_lock(&locked_session->lock);
-        DEBUG("UNLOCK wrlock %s", __func__);
-        if (pthread_rwlock_unlock(&session_lock) != 0) {
-            ERROR("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-        }
         if (locked_session->hello_message != NULL) {
-            reply = json_object_get(locked_session->hello_message);
+            reply = session_hello_copy(locked_session);
         } else {
             reply = create_error_reply("Invalid session identifier.");
         }
-        DEBUG("UNLOCK mutex %s", __func__);
-        pthread_mutex_unlock(&locked_session->lock);
+        session_unlock(locked_session);
     } else {
-        DEBUG("UNLOCK wrlock %s", __func__);
-        if (pthread_rwlock_unlock(&session_lock) != 0) {
-            ERROR("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-        }
         reply = create_error_reply("Invalid session identifier.");
     }
 
@@ -2911,24 +3347,20 @@ handle_op_generic(json_object *request, unsigned int session_key, int idx)
     json_object *reply = NULL, *contents, *obj;
     char *content = NULL, *str;
     struct lyd_node *data = NULL, *node_content;
-    struct session_with_mutex *locked_session;
+    struct session_with_mutex *locked_session = NULL;
 
     DEBUG("Request: generic request (session %u)", session_key);
 
-    pthread_mutex_lock(&json_lock);
     if (json_object_object_get_ex(request, "contents", &contents) == FALSE) {
-        pthread_mutex_unlock(&json_lock);
         reply = create_error_reply("Missing contents parameter.");
         goto finalize;
     }
     obj = json_object_array_get_idx(contents, idx);
     if (!obj) {
-        pthread_mutex_unlock(&json_lock);
         reply = create_error_reply("Contents array parameter shorter than sessions.");
         goto finalize;
     }
     content = strdup(json_object_get_string(obj));
-    pthread_mutex_unlock(&json_lock);
 
     locked_session = session_get_locked(session_key, NULL);
     if (!locked_session) {
@@ -2937,7 +3369,9 @@ handle_op_generic(json_object *request, unsigned int session_key, int idx)
     }
 
     node_content = lyd_parse_mem(nc_session_get_ctx(locked_session->session), content, LYD_JSON, LYD_OPT_RPC, NULL);
-    session_unlock(locked_session);
+    /* the content and the reply data are in the context of the session, keep the reference until they are freed */
+    DEBUG("UNLOCK mutex %s", __func__);
+    pthread_mutex_unlock(&locked_session->lock);
 
     free(content);
     lyd_print_mem(&content, node_content, LYD_XML, LYP_WITHSIBLINGS);
@@ -2952,10 +3386,8 @@ handle_op_generic(json_object *request, unsigned int session_key, int idx)
         }
     } else {
         if (data == NULL) {
-            pthread_mutex_lock(&json_lock);
             reply = json_object_new_object();
             json_object_object_add(reply, "type", json_object_new_int(REPLY_OK));
-            pthread_mutex_unlock(&json_lock);
         } else {
             lyd_print_mem(&str, data, LYD_JSON, LYP_WITHSIBLINGS);
             lyd_free_withsiblings(data);
@@ -2965,6 +3397,9 @@ handle_op_generic(json_object *request, unsigned int session_key, int idx)
     }
 
 finalize:
+    if (locked_session) {
+        session_put(locked_session);
+    }
     CHECK_AND_FREE(content);
     return reply;
 }
@@ -2980,11 +3415,9 @@ handle_op_getschema(json_object *request, unsigned int session_key)
 
     DEBUG("Request: get-schema (session %u)", session_key);
 
-    pthread_mutex_lock(&json_lock);
     identifier = get_param_string(request, "identifier");
     version = get_param_string(request, "version");
     format = get_param_string(request, "format");
-    pthread_mutex_unlock(&json_lock);
 
     if (identifier == NULL) {
         reply = create_error_reply("No identifier for get-schema supplied.");
@@ -2995,7 +3428,7 @@ handle_op_getschema(json_object *request, unsigned int session_key)
     if ((data = netconf_getschema(session_key, identifier, version, format, &reply)) == NULL) {
         CHECK_ERR_SET_REPLY_ERR("Get models operation failed.")
     } else {
-        reply = create_data_reply(data);
+        reply = create_text_data_reply(data);
         free(data);
     }
 
@@ -3015,18 +3448,10 @@ handle_op_reloadhello(json_object *UNUSED(request), unsigned int session_key)
 
     DEBUG("Request: reload hello (session %u)", session_key);
 
-    DEBUG("LOCK wrlock %s", __func__);
-    if (pthread_rwlock_wrlock(&session_lock) != 0) {
-        ERROR("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-        reply = create_error_reply("Internal error");
-    }
-
-    for (locked_session = netconf_sessions_list;
-         locked_session && (locked_session->session_key != session_key);
-         locked_session = locked_session->next);
+    locked_session = session_get_locked(session_key, NULL);
     if ((locked_session != NULL) && (locked_session->hello_message != NULL)) {
-        DEBUG("LOCK mutex %s", __func__);
-        pthread_mutex_lock(&locked_session->lock);
+        /* the new channel shares the SSH connection and the context with the dispatcher */
+        rpc_dispatcher_pause(locked_session->dispatcher);
         DEBUG("creating temporary NC session.");
         temp_session = nc_connect_ssh_channel(locked_session->session, NULL);
         if (temp_session != NULL) {
@@ -3034,28 +3459,20 @@ handle_op_reloadhello(json_object *UNUSED(request), unsigned int session_key)
             DEBUG("closing temporal NC session.");
             nc_session_free(temp_session, NULL);
             temp_session = NULL;
+            reply = session_hello_copy(locked_session);
         } else {
             DEBUG("Reload hello failed due to channel establishment");
             reply = create_error_reply("Reload was unsuccessful, connection failed.");
         }
-        DEBUG("UNLOCK mutex %s", __func__);
-        pthread_mutex_unlock(&locked_session->lock);
-        DEBUG("UNLOCK wrlock %s", __func__);
-        if (pthread_rwlock_unlock(&session_lock) != 0) {
-            ERROR("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-        }
+        rpc_dispatcher_resume(locked_session->dispatcher);
+        session_unlock(locked_session);
     } else {
-        DEBUG("UNLOCK wrlock %s", __func__);
-        if (pthread_rwlock_unlock(&session_lock) != 0) {
-            ERROR("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
+        if (locked_session != NULL) {
+            session_unlock(locked_session);
         }
         reply = create_error_reply("Invalid session identifier.");
     }
 
-    if ((reply == NULL) && (locked_session->hello_message != NULL)) {
-        reply = json_object_get(locked_session->hello_message);
-    }
-
     return reply;
 }
 
@@ -3074,11 +3491,10 @@ notification_history(struct nc_session *session, const struct nc_notif *notif)
         return;
     }
     DEBUG("Got notification from history %lu.", (long unsigned)eventtime);
-    pthread_mutex_lock(&json_lock);
     json_object *notif_obj = json_object_new_object();
     if (notif_obj == NULL) {
         ERROR("Could not allocate memory for notification (json).");
-        goto failed;
+        return;
     }
     lyd_print_mem(&content, notif->tree, LYD_JSON, 0);
 
@@ -3088,8 +3504,6 @@ notification_history(struct nc_session *session, const struct nc_notif *notif)
     free(content);
 
     json_object_array_add(notif_history_array, notif_obj);
-failed:
-    pthread_mutex_unlock(&json_lock);
 }
 
 json_object *
@@ -3106,37 +3520,23 @@ handle_op_ntfgethistory(json_object *request, unsigned int session_key)
 
     DEBUG("Request: get notification history (session %u)", session_key);
 
-    pthread_mutex_lock(&json_lock);
     if (json_object_object_get_ex(request, "from", &js_tmp) == TRUE) {
         from = json_object_get_int64(js_tmp);
     }
     if (json_object_object_get_ex(request, "to", &js_tmp) == TRUE) {
         to = json_object_get_int64(js_tmp);
     }
-    pthread_mutex_unlock(&json_lock);
 
     start = time(NULL) + from;
     stop = time(NULL) + to;
 
     DEBUG("notification history interval %li %li", (long int)from, (long int)to);
 
-    DEBUG("LOCK wrlock %s", __func__);
-    if (pthread_rwlock_rdlock(&session_lock) != 0) {
-        ERROR("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-        reply = create_error_reply("Internal lock failed.");
-        goto finalize;
-    }
-
-    for (locked_session = netconf_sessions_list;
-         locked_session && (locked_session->session_key != session_key);
-         locked_session = locked_session->next);
+    /* the reference keeps the session of the temporal one until the end */
+    locked_session = session_get_locked(session_key, NULL);
     if (locked_session != NULL) {
-        DEBUG("LOCK mutex %s", __func__);
-        pthread_mutex_lock(&locked_session->lock);
-        DEBUG("UNLOCK wrlock %s", __func__);
-        if (pthread_rwlock_unlock(&session_lock) != 0) {
-            ERROR("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-        }
+        /* the new channel shares the SSH connection and the context with the dispatcher */
+        rpc_dispatcher_pause(locked_session->dispatcher);
         DEBUG("creating temporal NC session.");
         temp_session = nc_connect_ssh_channel(locked_session->session, NULL);
         if (temp_session != NULL) {
@@ -3165,26 +3565,19 @@ handle_op_ntfgethistory(json_object *request, unsigned int session_key)
             pthread_mutex_unlock(&locked_session->lock);
             DEBUG("LOCK ntf mutex %s", __func__);
             pthread_mutex_lock(&ntf_history_lock);
-            pthread_mutex_lock(&json_lock);
             json_object *notif_history_array = json_object_new_array();
-            pthread_mutex_unlock(&json_lock);
             if (pthread_setspecific(notif_history_key, notif_history_array) != 0) {
                 ERROR("notif_history: cannot set thread-specific hash value.");
             }
 
             nc_recv_notif_dispatch(temp_session, notification_history);
 
-            pthread_mutex_lock(&json_lock);
             reply = json_object_new_object();
             json_object_object_add(reply, "notifications", notif_history_array);
             //json_object_put(notif_history_array);
-            pthread_mutex_unlock(&json_lock);
 
             DEBUG("UNLOCK ntf mutex %s", __func__);
             pthread_mutex_unlock(&ntf_history_lock);
-            DEBUG("closing temporal NC session.");
-            nc_session_free(temp_session, NULL);
-            temp_session = NULL;
         } else {
             DEBUG("UNLOCK mutex %s", __func__);
             pthread_mutex_unlock(&locked_session->lock);
@@ -3192,14 +3585,18 @@ handle_op_ntfgethistory(json_object *request, unsigned int session_key)
             reply = create_error_reply("Get history of notification was unsuccessful, connection failed.");
         }
     } else {
-        DEBUG("UNLOCK wrlock %s", __func__);
-        if (pthread_rwlock_unlock(&session_lock) != 0) {
-            ERROR("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-        }
         reply = create_error_reply("Invalid session identifier.");
     }
 
 finalize:
+    if (temp_session != NULL) {
+        DEBUG("closing temporal NC session.");
+        nc_session_free(temp_session, NULL);
+    }
+    if (locked_session != NULL) {
+        rpc_dispatcher_resume(locked_session->dispatcher);
+        session_put(locked_session);
+    }
     return reply;
 }
 
@@ -3214,10 +3611,8 @@ handle_op_validate(json_object *request, unsigned int session_key)
 
     DEBUG("Request: validate datastore (session %u)", session_key);
 
-    pthread_mutex_lock(&json_lock);
     target = get_param_string(request, "target");
     url = get_param_string(request, "url");
-    pthread_mutex_unlock(&json_lock);
 
 
     if (target == NULL) {
@@ -3292,22 +3687,18 @@ handle_op_query(json_object *request, unsigned int session_key, int idx)
 
     DEBUG("Request: query (session %u)", session_key);
 
-    pthread_mutex_lock(&json_lock);
     if (json_object_object_get_ex(request, "filters", &filters) == FALSE) {
-        pthread_mutex_unlock(&json_lock);
         reply = create_error_reply("Missing filters parameter.");
         goto finalize;
     }
     filter_array = json_object_array_get_idx(filters, idx);
     if (!filter_array || (json_object_get_type(filter_array) != json_type_array)) {
-        pthread_mutex_unlock(&json_lock);
         reply = create_error_reply("Filters array parameter wrong.");
         goto finalize;
     }
     if (json_object_object_get_ex(request, "load_children", &obj) == TRUE) {
         load_children = json_object_get_boolean(obj);
     }
-    pthread_mutex_unlock(&json_lock);
 
     reply = libyang_query(session_key, filter_array, load_children);
 
@@ -3321,7 +3712,7 @@ finalize:
 }
 
 json_object *
-handle_op_merge(json_object *request, unsigned int session_key, int idx)
+handle_op_merge(json_object *request, unsigned int session_key, int idx, const struct data_print_opts *print_opts)
 {
     json_object *reply = NULL, *configs, *obj;
     char *config = NULL;
@@ -3330,20 +3721,16 @@ handle_op_merge(json_object *request, unsigned int session_key, int idx)
 
     DEBUG("Request: merge (session %u)", session_key);
 
-    pthread_mutex_lock(&json_lock);
     if (json_object_object_get_ex(request, "configurations", &configs) == FALSE) {
-        pthread_mutex_unlock(&json_lock);
         reply = create_error_reply("Missing configurations parameter.");
         goto finalize;
     }
     obj = json_object_array_get_idx(configs, idx);
     if (!obj) {
-        pthread_mutex_unlock(&json_lock);
         reply = create_error_reply("Filters array parameter shorter than sessions.");
         goto finalize;
     }
     config = strdup(json_object_get_string(obj));
-    pthread_mutex_unlock(&json_lock);
 
     locked_session = session_get_locked(session_key, NULL);
     if (!locked_session) {
@@ -3352,13 +3739,16 @@ handle_op_merge(json_object *request, unsigned int session_key, int idx)
     }
 
     content = lyd_parse_mem(nc_session_get_ctx(locked_session->session), config, LYD_JSON, LYD_OPT_DATA);
-    session_unlock(locked_session);
+    /* the content is in the context of the session, keep the reference until it is freed */
+    DEBUG("UNLOCK mutex %s", __func__);
+    pthread_mutex_unlock(&locked_session->lock);
 
     free(config);
     lyd_print_mem(&config, content, LYD_XML, LYP_WITHSIBLINGS);
     lyd_free_withsiblings(content);
+    session_put(locked_session);
 
-    reply = libyang_merge(session_key, config);
+    reply = libyang_merge(session_key, config, print_opts);
 
     CHECK_ERR_SET_REPLY
     if (!reply) {
@@ -3370,357 +3760,1151 @@ finalize:
     return reply;
 }
 
-void *
-thread_routine(void *arg)
+/**
+ * \brief Get the optional "request-id" of a request received from a frontend.
+ *
+ * \param[in] request parsed request
+ * \return "request-id" of the request, NULL if not present.
+ */
+static json_object *
+request_get_id(json_object *request)
 {
-    void *retval = NULL;
-    struct pollfd fds;
-    json_object *request = NULL, *replies = NULL, *reply, *sessions = NULL;
-    json_object *js_tmp = NULL;
-    int operation = (-1), count, i, sent;
-    int status = 0;
-    const char *msgtext;
-    unsigned int session_key = 0;
-    char *chunked_out_msg = NULL;
-    int client = ((struct pass_to_thread *)arg)->client;
-
-    char *buffer = NULL;
-
-    /* init thread specific err_reply memory */
-    create_err_reply_p();
-
-    while (!isterminated) {
-        fds.fd = client;
-        fds.events = POLLIN;
-        fds.revents = 0;
-
-        status = poll(&fds, 1, 1000);
-
-        if (status == 0 || (status == -1 && (errno == EAGAIN || (errno == EINTR && isterminated == 0)))) {
-            /* poll was interrupted - check if the isterminated is set and if not, try poll again */
-            continue;
-        } else if (status < 0) {
-            /* 0:  poll time outed
-             *     close socket and ignore this request from the client, it can try it again
-             * -1: poll failed
-             *     something wrong happend, close this socket and wait for another request
-             */
-            close(client);
-            break;
-        }
-        /* status > 0 */
-
-        /* check the status of the socket */
-
-        /* if nothing to read and POLLHUP (EOF) or POLLERR set */
-        if ((fds.revents & POLLHUP) || (fds.revents & POLLERR)) {
-            /* close client's socket (it's probably already closed by client */
-            close(client);
-            break;
-        }
-
-        buffer = get_framed_message(client);
-        if (buffer != NULL) {
-            DEBUG("Received message:\n%.*s\n", 1024, buffer);
-            enum json_tokener_error jerr;
-            pthread_mutex_lock(&json_lock);
-            request = json_tokener_parse_verbose(buffer, &jerr);
-            if (jerr != json_tokener_success) {
-                ERROR("JSON parsing error");
-                pthread_mutex_unlock(&json_lock);
-                continue;
-            }
+    json_object *request_id = NULL, *type = NULL;
 
-            if (json_object_object_get_ex(request, "type", &js_tmp) == TRUE) {
-                operation = json_object_get_int(js_tmp);
-            }
-            pthread_mutex_unlock(&json_lock);
-            if (operation == -1) {
-                replies = create_replies();
-                add_reply(replies, create_error_reply("Missing operation type from frontend."), 0);
-                goto send_reply;
-            }
+    /* the request itself is not logged, it may be large and carry a password */
+    json_object_object_get_ex(request, "type", &type);
+    json_object_object_get_ex(request, "request-id", &request_id);
+    DEBUG("Received request (type %d, request-id %s).", json_object_get_int(type),
+          request_id ? json_object_get_string(request_id) : "none");
 
-            if ((operation < 4) || ((operation > 20) && (operation < 100)) || (operation > 101)) {
-                DEBUG("Unknown mod_netconf operation requested (%d)", operation);
-                replies = create_replies();
-                add_reply(replies, create_error_reply("Operation not supported."), 0);
-                goto send_reply;
-            }
+    return request_id;
+}
 
-            DEBUG("operation %d", operation);
+/**
+ * \brief Process the operation of a request on a single session.
+ *
+ * \param[in] request parsed request
+ * \param[in] operation operation of the request
+ * \param[in] session_key session to work with
+ * \param[in] idx index of the session in the "sessions" array of the request
+ * \param[in] print_opts metadata options of data replies
+ * \return reply of the session.
+ */
+static json_object *
+process_session(json_object *request, int operation, unsigned int session_key, int idx,
+                const struct data_print_opts *print_opts)
+{
+    json_object *reply = NULL;
+    json_object **err_reply_p;
 
-            /* null global JSON error-reply */
-            clean_err_reply();
+    switch (operation) {
+    case MSG_CONNECT:
+        reply = handle_op_connect(request);
+        break;
+    case MSG_DISCONNECT:
+        reply = handle_op_disconnect(request, session_key);
+        break;
+    case MSG_GET:
+        reply = handle_op_get(request, session_key, print_opts);
+        break;
+    case MSG_GETCONFIG:
+        reply = handle_op_getconfig(request, session_key, print_opts);
+        break;
+    case MSG_EDITCONFIG:
+        reply = handle_op_editconfig(request, session_key, idx);
+        break;
+    case MSG_COPYCONFIG:
+        reply = handle_op_copyconfig(request, session_key, idx);
+        break;
+    case MSG_DELETECONFIG:
+        reply = handle_op_deleteconfig(request, session_key);
+        break;
+    case MSG_LOCK:
+        reply = handle_op_lock(request, session_key);
+        break;
+    case MSG_UNLOCK:
+        reply = handle_op_unlock(request, session_key);
+        break;
+    case MSG_KILL:
+        reply = handle_op_kill(request, session_key);
+        break;
+    case MSG_INFO:
+        reply = handle_op_info(request, session_key);
+        break;
+    case MSG_GENERIC:
+        reply = handle_op_generic(request, session_key, idx);
+        break;
+    case MSG_GETSCHEMA:
+        reply = handle_op_getschema(request, session_key);
+        break;
+    case MSG_RELOADHELLO:
+        reply = handle_op_reloadhello(request, session_key);
+        break;
+    case MSG_NTF_GETHISTORY:
+        reply = handle_op_ntfgethistory(request, session_key);
+        break;
+    case MSG_VALIDATE:
+        reply = handle_op_validate(request, session_key);
+        break;
+    case MSG_COMMIT:
+        reply = handle_op_commit(session_key);
+        break;
+    case MSG_EXPAND:
+        reply = handle_op_expand(request, session_key, print_opts);
+        break;
+    case SCH_QUERY:
+        reply = handle_op_query(request, session_key, idx);
+        break;
+    case SCH_MERGE:
+        reply = handle_op_merge(request, session_key, idx, print_opts);
+        break;
+    }
 
-            /* clean replies envelope */
-            if (replies != NULL) {
-                pthread_mutex_lock(&json_lock);
-                json_object_put(replies);
-                pthread_mutex_unlock(&json_lock);
-            }
-            replies = create_replies();
+    /* the reply may be the thread's error reply, it is owned by the replies from now on */
+    err_reply_p = (json_object **)pthread_getspecific(err_reply_key);
+    if (err_reply_p && (*err_reply_p == reply)) {
+        *err_reply_p = NULL;
+    }
+    clean_err_reply();
 
-            if (operation == MSG_CONNECT) {
-                count = 1;
-            } else {
-                pthread_mutex_lock(&json_lock);
-                if (json_object_object_get_ex(request, "sessions", &sessions) == FALSE) {
-                    pthread_mutex_unlock(&json_lock);
-                    add_reply(replies, create_error_reply("Operation missing \"sessions\" arg"), 0);
-                    goto send_reply;
-                }
-                count = json_object_array_length(sessions);
-                pthread_mutex_unlock(&json_lock);
-            }
+    return reply;
+}
 
-            for (i = 0; i < count; ++i) {
-                if (operation != MSG_CONNECT) {
-                    js_tmp = json_object_array_get_idx(sessions, i);
-                    session_key = json_object_get_int(js_tmp);
-                }
+/**
+ * \brief Send the reply of a single session to the frontend right away.
+ *
+ * \param[in] conn frontend connection
+ * \param[in] reply reply of the session, it is freed
+ * \param[in] session_key session the reply belongs to
+ * \param[in] request request the reply belongs to
+ */
+static void
+stream_reply(struct client_conn *conn, json_object *reply, unsigned int session_key, json_object *request)
+{
+    json_object *replies;
 
-                /* process required operation */
-                reply = NULL;
-                switch (operation) {
-                case MSG_CONNECT:
-                    reply = handle_op_connect(request);
-                    break;
-                case MSG_DISCONNECT:
-                    reply = handle_op_disconnect(request, session_key);
-                    break;
-                case MSG_GET:
-                    reply = handle_op_get(request, session_key);
-                    break;
-                case MSG_GETCONFIG:
-                    reply = handle_op_getconfig(request, session_key);
-                    break;
-                case MSG_EDITCONFIG:
-                    reply = handle_op_editconfig(request, session_key, i);
-                    break;
-                case MSG_COPYCONFIG:
-                    reply = handle_op_copyconfig(request, session_key, i);
-                    break;
-                case MSG_DELETECONFIG:
-                    reply = handle_op_deleteconfig(request, session_key);
-                    break;
-                case MSG_LOCK:
-                    reply = handle_op_lock(request, session_key);
-                    break;
-                case MSG_UNLOCK:
-                    reply = handle_op_unlock(request, session_key);
-                    break;
-                case MSG_KILL:
-                    reply = handle_op_kill(request, session_key);
-                    break;
-                case MSG_INFO:
-                    reply = handle_op_info(request, session_key);
-                    break;
-                case MSG_GENERIC:
-                    reply = handle_op_generic(request, session_key, i);
-                    break;
-                case MSG_GETSCHEMA:
-                    reply = handle_op_getschema(request, session_key);
-                    break;
-                case MSG_RELOADHELLO:
-                    reply = handle_op_reloadhello(request, session_key);
-                    break;
-                case MSG_NTF_GETHISTORY:
-                    reply = handle_op_ntfgethistory(request, session_key);
-                    break;
-                case MSG_VALIDATE:
-                    reply = handle_op_validate(request, session_key);
-                    break;
-                case MSG_COMMIT:
-                    reply = handle_op_commit(session_key);
-                    break;
-                case SCH_QUERY:
-                    reply = handle_op_query(request, session_key, i);
-                    break;
-                case SCH_MERGE:
-                    reply = handle_op_merge(request, session_key, i);
-                    break;
-                }
+    replies = create_replies();
+    add_reply(replies, reply, session_key);
+    conn_send_replies(conn, replies, request);
+}
 
-                add_reply(replies, reply, session_key);
-            }
+/**
+ * \brief Process the next sessions of a fan-out until there are none left.
+ *
+ * json-c objects are not thread-safe, so a helper works with its own copy of
+ * the request. It is made only when the helper gets a session to process.
+ *
+ * \param[in] fanout fan-out to work on
+ * \param[in] helper whether called by a helper job or by the thread owning the request
+ */
+static void
+fanout_run(struct fanout *fanout, int helper)
+{
+    json_object *reply, *request = NULL;
+    int i;
 
-            /* free parameters */
-            operation = (-1);
+    while (1) {
+        pthread_mutex_lock(&fanout->lock);
+        if (fanout->next == fanout->count) {
+            pthread_mutex_unlock(&fanout->lock);
+            break;
+        }
+        i = fanout->next++;
+        pthread_mutex_unlock(&fanout->lock);
 
-            if (request != NULL) {
-                pthread_mutex_lock(&json_lock);
-                json_object_put(request);
-                pthread_mutex_unlock(&json_lock);
+        if (!request) {
+            if (!helper) {
+                request = fanout->request;
+            } else if (json_object_deep_copy(fanout->request, &request, NULL)) {
                 request = NULL;
             }
+        }
 
-send_reply:
-            /* send reply to caller */
-            if (replies) {
-                pthread_mutex_lock(&json_lock);
-                msgtext = json_object_to_json_string(replies);
-                pthread_mutex_unlock(&json_lock);
-                DEBUG("Sending message:\n%.*s\n", 1024, msgtext);
-                if (asprintf(&chunked_out_msg, "\n#%d\n%s\n##\n", (int)strlen(msgtext), msgtext) == -1) {
-                    if (buffer != NULL) {
-                        free(buffer);
-                        buffer = NULL;
-                    }
-                    break;
-                }
+        if (request) {
+            reply = process_session(request, fanout->operation, fanout->session_keys[i], i, fanout->print_opts);
+        } else {
+            ERROR("Copying the request failed.");
+            reply = create_error_reply("Memory allocation failed.");
+        }
+        if (fanout->conn) {
+            stream_reply(fanout->conn, reply, fanout->session_keys[i], request);
+            reply = NULL;
+        }
 
-                i = 0;
-                sent = 0;
-                count = strlen(chunked_out_msg) + 1;
-                while (count && ((i = send(client, chunked_out_msg + sent, count, 0)) != -1)) {
-                    sent += i;
-                    count -= i;
-                }
-                if (i == -1) {
-                    ERROR("Sending message failed (%s).", strerror(errno));
-                }
-                pthread_mutex_lock(&json_lock);
-                json_object_put(replies);
-                pthread_mutex_unlock(&json_lock);
-                replies = NULL;
-
-                CHECK_AND_FREE(chunked_out_msg);
-                chunked_out_msg = NULL;
-                if (buffer) {
-                    free(buffer);
-                    buffer = NULL;
-                }
-                clean_err_reply();
-            } else {
-                ERROR("Reply is NULL, shouldn't be...");
-                continue;
-            }
+        pthread_mutex_lock(&fanout->lock);
+        fanout->replies[i] = reply;
+        if (++fanout->done == fanout->count) {
+            pthread_cond_signal(&fanout->cond);
         }
+        pthread_mutex_unlock(&fanout->lock);
     }
-    free(arg);
-    free_err_reply();
-    nc_thread_destroy();
 
-    return retval;
+    if (helper) {
+        json_object_put(request);
+    }
 }
 
 /**
- * \brief Close all open NETCONF sessions.
- *
- * During termination of mod_netconf, it is useful to close all remaining
- * sessions. This function iterates over the list of sessions and close them
- * all.
+ * \brief Release a reference of a fan-out, the last one frees it.
  */
 static void
-close_all_nc_sessions(void)
+fanout_put(struct fanout *fanout)
 {
-    struct session_with_mutex *locked_session, *next_session;
-    int ret;
+    unsigned int refcount;
 
-    /* get exclusive access to sessions_list (conns) */
-    DEBUG("LOCK wrlock %s", __func__);
-    if ((ret = pthread_rwlock_wrlock(&session_lock)) != 0) {
-        ERROR("Error while locking rwlock: %d (%s)", ret, strerror(ret));
+    pthread_mutex_lock(&fanout->lock);
+    refcount = --fanout->refcount;
+    pthread_mutex_unlock(&fanout->lock);
+    if (refcount) {
         return;
     }
-    for (next_session = netconf_sessions_list; next_session;) {
-        locked_session = next_session;
-        next_session = locked_session->next;
 
-        /* close_and_free_session handles locking on its own */
-        DEBUG("Closing NETCONF session %u (SID %u).", locked_session->session_key, nc_session_get_id(locked_session->session));
-        close_and_free_session(locked_session);
-    }
-    netconf_sessions_list = NULL;
+    pthread_mutex_destroy(&fanout->lock);
+    pthread_cond_destroy(&fanout->cond);
+    free(fanout->session_keys);
+    free(fanout->replies);
+    free(fanout);
+}
 
-    /* get exclusive access to sessions_list (conns) */
-    DEBUG("UNLOCK wrlock %s", __func__);
-    if (pthread_rwlock_unlock(&session_lock) != 0) {
-        ERROR("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-    }
+/**
+ * \brief Worker job helping with a fan-out.
+ */
+static void
+fanout_worker(void *arg)
+{
+    struct fanout *fanout = (struct fanout *)arg;
+
+    fanout_run(fanout, 1);
+    fanout_put(fanout);
 }
 
+/**
+ * \brief Process the operation of a request on all its sessions in parallel.
+ *
+ * The calling thread processes sessions itself and up to fanout_limit - 1 worker
+ * jobs help it. Helper jobs that start after all the sessions were claimed
+ * just terminate, so the request never waits for a free worker.
+ *
+ * \param[in] request parsed request
+ * \param[in] operation operation of the request
+ * \param[in] session_keys sessions of the request
+ * \param[in] count number of sessions
+ * \param[in] replies replies envelope to add the replies to
+ * \param[in] conn frontend connection to stream the replies to, NULL to add them to replies
+ * \param[in] print_opts metadata options of data replies
+ */
 static void
-check_timeout_and_close(void)
+process_fanout(json_object *request, int operation, unsigned int *session_keys, int count, json_object *replies,
+               struct client_conn *conn, const struct data_print_opts *print_opts)
 {
-    struct session_with_mutex *locked_session = NULL, *next_session;
-    time_t current_time = time(NULL);
-    int ret;
+    struct fanout *fanout;
+    int i;
 
-    /* get exclusive access to sessions_list (conns) */
-    //DEBUG("LOCK wrlock %s", __func__);
-    if ((ret = pthread_rwlock_wrlock(&session_lock)) != 0) {
-        DEBUG("Error while locking rwlock: %d (%s)", ret, strerror(ret));
+    fanout = calloc(1, sizeof *fanout);
+    if (fanout) {
+        fanout->replies = calloc(count, sizeof *fanout->replies);
+    }
+    if (!fanout || !fanout->replies) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        free(fanout);
+        free(session_keys);
+        for (i = 0; i < count; ++i) {
+            add_reply(replies, create_error_reply("Memory allocation failed."), 0);
+        }
         return;
     }
-
-    locked_session = netconf_sessions_list;
-    while (locked_session) {
-        next_session = locked_session->next;
-
-        if (!locked_session->session) {
-            continue;
+    pthread_mutex_init(&fanout->lock, NULL);
+    pthread_cond_init(&fanout->cond, NULL);
+    fanout->refcount = 1;
+    fanout->request = request;
+    fanout->operation = operation;
+    fanout->session_keys = session_keys;
+    fanout->count = count;
+    fanout->conn = conn;
+    fanout->print_opts = print_opts;
+
+    for (i = 1; (i < count) && (i < (signed)fanout_limit); ++i) {
+        pthread_mutex_lock(&fanout->lock);
+        ++fanout->refcount;
+        pthread_mutex_unlock(&fanout->lock);
+        if (worker_pool_submit(workers, fanout_worker, fanout)) {
+            fanout_put(fanout);
+            break;
         }
-        if ((current_time - locked_session->last_activity) > ACTIVITY_TIMEOUT) {
-            DEBUG("Closing NETCONF session %u (SID %u).", locked_session->session_key, nc_session_get_id(locked_session->session));
-
-            /* remove it from the list */
-            if (!locked_session->prev) {
-                netconf_sessions_list = netconf_sessions_list->next;
-                if (netconf_sessions_list) {
-                    netconf_sessions_list->prev = NULL;
-                }
-            } else {
-                locked_session->prev->next = locked_session->next;
-                if (locked_session->next) {
-                    locked_session->next->prev = locked_session->prev;
-                }
-            }
+    }
 
-            /* close_and_free_session handles locking on its own */
-            close_and_free_session(locked_session);
-        }
+    fanout_run(fanout, 0);
 
-        locked_session = next_session;
+    /* wait for the sessions processed by the helpers */
+    pthread_mutex_lock(&fanout->lock);
+    while (fanout->done < fanout->count) {
+        pthread_cond_wait(&fanout->cond, &fanout->lock);
     }
-    //DEBUG("UNLOCK wrlock %s", __func__);
-    if (pthread_rwlock_unlock(&session_lock) != 0) {
-        ERROR("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
+    pthread_mutex_unlock(&fanout->lock);
+
+    if (!conn) {
+        for (i = 0; i < count; ++i) {
+            add_reply(replies, fanout->replies[i], session_keys[i]);
+        }
     }
+    fanout_put(fanout);
 }
 
-
 /**
- * This is actually implementation of NETCONF client
- * - requests are received from UNIX socket in the predefined format
- * - results are replied through the same way
- * - the daemon run as a separate process
+ * \brief Parse a page of a list requested by "pages".
  *
+ * \param[in] page_obj object with "path", optional "offset", "limit", "sort" and "descending"
+ * \param[out] page parsed page, its strings are to be freed even on error
+ * \param[out] errmsg error message on error
+ * \return 0 on success, 1 on error.
  */
-static void
-forked_proc(void)
+static int
+data_page_parse(json_object *page_obj, struct data_page *page, const char **errmsg)
 {
-    struct timeval tv;
-    struct sockaddr_un local, remote;
-    int lsock, client, ret, i, pthread_count = 0;
-    unsigned int olds = 0, timediff = 0;
-    socklen_t len;
-    struct pass_to_thread *arg;
-    pthread_t *ptids = calloc(1, sizeof(pthread_t));
-    struct timespec maxtime;
-    pthread_rwlockattr_t lock_attrs;
-    #ifdef WITH_NOTIFICATIONS
-    char use_notifications = 0;
-    #endif
+    json_object *js_tmp;
 
-    /* wait at most 5 seconds for every thread to terminate */
-    maxtime.tv_sec = 5;
-    maxtime.tv_nsec = 0;
+    if (!json_object_is_type(page_obj, json_type_object) || !json_object_object_get_ex(page_obj, "path", &js_tmp)
+            || !json_object_is_type(js_tmp, json_type_string)) {
+        *errmsg = "Invalid page requested, a list path is required.";
+        return 1;
+    }
+    /* copied, the request is not shared with the other threads */
+    page->path = strdup(json_object_get_string(js_tmp));
+    if (!page->path) {
+        *errmsg = "Memory allocation failed.";
+        return 1;
+    }
 
-#ifdef HAVE_UNIXD_SETUP_CHILD
-    /* change uid and gid of process for security reasons */
-    unixd_setup_child();
+    if (json_object_object_get_ex(page_obj, "offset", &js_tmp)) {
+        if (json_object_get_int64(js_tmp) < 0) {
+            *errmsg = "Invalid page offset requested.";
+            return 1;
+        }
+        page->offset = json_object_get_int64(js_tmp) > UINT_MAX ? UINT_MAX : json_object_get_int64(js_tmp);
+    }
+    if (json_object_object_get_ex(page_obj, "limit", &js_tmp)) {
+        if (json_object_get_int64(js_tmp) < 0) {
+            *errmsg = "Invalid page limit requested.";
+            return 1;
+        }
+        page->limit = json_object_get_int64(js_tmp) > UINT_MAX ? UINT_MAX : json_object_get_int64(js_tmp);
+    }
+    if (json_object_object_get_ex(page_obj, "sort", &js_tmp)) {
+        page->sort = strdup(json_object_get_string(js_tmp));
+        if (!page->sort) {
+            *errmsg = "Memory allocation failed.";
+            return 1;
+        }
+    }
+    if (json_object_object_get_ex(page_obj, "descending", &js_tmp)) {
+        page->descending = json_object_get_boolean(js_tmp);
+    }
+    return 0;
+}
+
+/**
+ * \brief Parse the metadata options of a get, get-config or merge request.
+ *
+ * \param[in] request parsed request
+ * \param[out] print_opts parsed options, to be cleaned by data_print_opts_clean()
+ * \param[out] errmsg reason the options are invalid
+ * \return 0 on success, 1 on error.
+ */
+static int
+data_print_opts_parse(json_object *request, struct data_print_opts *print_opts, const char **errmsg)
+{
+    json_object *js_tmp, *path;
+    const char *level;
+    int i;
+
+    memset(print_opts, 0, sizeof *print_opts);
+    print_opts->metadata = METADATA_FULL;
+
+    if (json_object_object_get_ex(request, "metadata", &js_tmp) == TRUE) {
+        level = json_object_get_string(js_tmp);
+        if (!strcmp(level, "none")) {
+            print_opts->metadata = METADATA_NONE;
+        } else if (!strcmp(level, "minimal")) {
+            print_opts->metadata = METADATA_MINIMAL;
+        } else if (strcmp(level, "full")) {
+            *errmsg = "Invalid metadata level requested.";
+            return 1;
+        }
+    }
+
+    if ((json_object_object_get_ex(request, "metadata-paths", &js_tmp) == TRUE)
+            && json_object_is_type(js_tmp, json_type_array)) {
+        print_opts->paths = calloc(json_object_array_length(js_tmp) + 1, sizeof *print_opts->paths);
+        if (!print_opts->paths) {
+            *errmsg = "Memory allocation failed.";
+            return 1;
+        }
+        for (i = 0; i < (signed)json_object_array_length(js_tmp); ++i) {
+            path = json_object_array_get_idx(js_tmp, i);
+            if (!json_object_is_type(path, json_type_string)) {
+                *errmsg = "Invalid metadata path requested.";
+                return 1;
+            }
+            /* copied, the request is not shared with the other threads */
+            print_opts->paths[i] = strdup(json_object_get_string(path));
+            if (!print_opts->paths[i]) {
+                *errmsg = "Memory allocation failed.";
+                return 1;
+            }
+            ++print_opts->path_count;
+        }
+    }
+
+    if ((json_object_object_get_ex(request, "pages", &js_tmp) == TRUE) && json_object_is_type(js_tmp, json_type_array)) {
+        print_opts->pages = calloc(json_object_array_length(js_tmp) + 1, sizeof *print_opts->pages);
+        if (!print_opts->pages) {
+            *errmsg = "Memory allocation failed.";
+            return 1;
+        }
+        for (i = 0; i < (signed)json_object_array_length(js_tmp); ++i) {
+            if (data_page_parse(json_object_array_get_idx(js_tmp, i), &print_opts->pages[i], errmsg)) {
+                return 1;
+            }
+            ++print_opts->page_count;
+        }
+    }
+
+    if (json_object_object_get_ex(request, "depth", &js_tmp) == TRUE) {
+        if (json_object_get_int64(js_tmp) < 0) {
+            *errmsg = "Invalid depth requested.";
+            return 1;
+        }
+        print_opts->depth = json_object_get_int64(js_tmp) > UINT_MAX ? UINT_MAX : json_object_get_int64(js_tmp);
+    }
+
+    if ((print_opts->metadata != METADATA_NONE) && (json_object_object_get_ex(request, "schema-dictionary", &js_tmp) == TRUE)
+            && json_object_get_boolean(js_tmp)) {
+        print_opts->dict = metadata_dict_new();
+        if (!print_opts->dict) {
+            *errmsg = "Memory allocation failed.";
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void
+data_print_opts_clean(struct data_print_opts *print_opts)
+{
+    unsigned int i;
+
+    for (i = 0; i < print_opts->path_count; ++i) {
+        free(print_opts->paths[i]);
+    }
+    free(print_opts->paths);
+    if (print_opts->pages) {
+        /* the page being parsed on error is not counted yet */
+        for (i = 0; i <= print_opts->page_count; ++i) {
+            free(print_opts->pages[i].path);
+            free(print_opts->pages[i].sort);
+        }
+    }
+    free(print_opts->pages);
+    metadata_dict_free(print_opts->dict);
+    memset(print_opts, 0, sizeof *print_opts);
+}
+
+/**
+ * \brief Add the schema metadata dictionary to replies envelope as "schema".
+ */
+static void
+add_schema_dict(json_object *replies, struct metadata_dict *dict)
+{
+    struct json_writer writer;
+    json_object *schema;
+    const char *json;
+    size_t len;
+
+    json_writer_init(&writer, 0);
+    metadata_dict_write(dict, &writer);
+    json = json_writer_finish(&writer, &len);
+    if (json) {
+        /* written to the frontend as it is, see write_reply() */
+        schema = json_object_new_string_len(json, len);
+        json_object_set_userdata(schema, (void *)&data_is_json, NULL);
+        json_object_object_add(replies, "schema", schema);
+    } else {
+        ERROR("Printing the schema dictionary failed.");
+    }
+    json_writer_clean(&writer);
+}
+
+/**
+ * \brief Process a single request of a frontend.
+ *
+ * If the request asks for streaming, the reply of every session is sent to the
+ * frontend as soon as it is ready and the returned envelope only completes the
+ * stream.
+ *
+ * If the request asks for a schema dictionary, the metadata of all the data
+ * replies are collected in the "schema" member of the returned envelope.
+ *
+ * \param[in] request parsed request, it is not freed
+ * \param[in] conn frontend connection the request was received from
+ * \return replies envelope to be sent to the frontend.
+ */
+static json_object *
+process_request(json_object *request, struct client_conn *conn)
+{
+    json_object *replies = NULL, *sessions = NULL;
+    json_object *js_tmp = NULL;
+    int operation = (-1), count, i;
+    unsigned int *session_keys;
+    struct client_conn *stream = NULL;
+    const char *errmsg;
+    struct data_print_opts print_opts;
+
+    memset(&print_opts, 0, sizeof print_opts);
+
+    if (json_object_object_get_ex(request, "type", &js_tmp) == TRUE) {
+        operation = json_object_get_int(js_tmp);
+    }
+    if ((json_object_object_get_ex(request, "stream", &js_tmp) == TRUE) && json_object_get_boolean(js_tmp)) {
+        stream = conn;
+    }
+    if (operation == -1) {
+        replies = create_replies();
+        add_reply(replies, create_error_reply("Missing operation type from frontend."), 0);
+        goto finalize;
+    }
+
+    if ((operation < MSG_CONNECT) || ((operation > MSG_EXPAND) && (operation < SCH_QUERY)) || (operation > SCH_MERGE)) {
+        DEBUG("Unknown mod_netconf operation requested (%d)", operation);
+        replies = create_replies();
+        add_reply(replies, create_error_reply("Operation not supported."), 0);
+        goto finalize;
+    }
+
+    DEBUG("operation %d", operation);
+
+    /* null global JSON error-reply */
+    clean_err_reply();
+
+    replies = create_replies();
+
+    if ((operation == MSG_GET) || (operation == MSG_GETCONFIG) || (operation == MSG_EXPAND) || (operation == SCH_MERGE)) {
+        if (data_print_opts_parse(request, &print_opts, &errmsg)) {
+            add_reply(replies, create_error_reply(errmsg), 0);
+            goto finalize;
+        }
+    }
+
+    if (operation == MSG_CONNECT) {
+        if (stream) {
+            stream_reply(stream, process_session(request, operation, 0, 0, NULL), 0, request);
+        } else {
+            add_reply(replies, process_session(request, operation, 0, 0, NULL), 0);
+        }
+        goto finalize;
+    }
+
+    if (json_object_object_get_ex(request, "sessions", &sessions) == FALSE) {
+        add_reply(replies, create_error_reply("Operation missing \"sessions\" arg"), 0);
+        goto finalize;
+    }
+    count = json_object_array_length(sessions);
+    session_keys = malloc(count * sizeof *session_keys);
+    for (i = 0; session_keys && (i < count); ++i) {
+        js_tmp = json_object_array_get_idx(sessions, i);
+        session_keys[i] = json_object_get_int(js_tmp);
+    }
+    if (count && !session_keys) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        add_reply(replies, create_error_reply("Memory allocation failed."), 0);
+        goto finalize;
+    }
+
+    if ((count > 1) && (fanout_limit > 1)) {
+        process_fanout(request, operation, session_keys, count, replies, stream, &print_opts);
+    } else {
+        for (i = 0; i < count; ++i) {
+            if (stream) {
+                stream_reply(stream, process_session(request, operation, session_keys[i], i, &print_opts), session_keys[i], request);
+            } else {
+                add_reply(replies, process_session(request, operation, session_keys[i], i, &print_opts), session_keys[i]);
+            }
+        }
+        free(session_keys);
+    }
+
+finalize:
+    if (print_opts.dict) {
+        add_schema_dict(replies, print_opts.dict);
+    }
+    data_print_opts_clean(&print_opts);
+    if (stream) {
+        /* completion marker, it may also carry errors of the request itself */
+        json_object_object_add(replies, "done", json_object_new_boolean(1));
+    }
+    return replies;
+}
+
+/**
+ * \brief Release a reference of a frontend connection, the last one frees it.
+ */
+static void
+conn_put(struct client_conn *conn)
+{
+    struct conn_msg *msg;
+    unsigned int refcount;
+
+    pthread_mutex_lock(&conn->lock);
+    refcount = --conn->refcount;
+    pthread_mutex_unlock(&conn->lock);
+    if (refcount) {
+        return;
+    }
+
+    while ((msg = conn->pending)) {
+        conn->pending = msg->next;
+        json_object_put(msg->request);
+        free(msg);
+    }
+    frame_reader_clean(&conn->reader);
+    close(conn->fd);
+    pthread_mutex_destroy(&conn->lock);
+    pthread_mutex_destroy(&conn->send_lock);
+    free(conn);
+}
+
+/**
+ * \brief Resume reading a throttled connection when its backlog got small enough.
+ *
+ * Connection lock is expected to be held.
+ */
+static void
+conn_resume(struct client_conn *conn)
+{
+    struct epoll_event ev;
+
+    if (conn->throttled && !conn->closed && (conn->pending_count + conn->inflight < CONN_MAX_PENDING)) {
+        memset(&ev, 0, sizeof ev);
+        ev.events = EPOLLIN;
+        ev.data.fd = conn->fd;
+        epoll_ctl(reactor_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+        conn->throttled = 0;
+    }
+}
+
+/**
+ * \brief Send replies to a frontend and free them.
+ *
+ * \param[in] conn frontend connection
+ * \param[in] replies replies envelope
+ * \param[in] request request the replies belong to, its "request-id" and "raw-data" are applied, can be NULL
+ */
+static void
+conn_send_replies(struct client_conn *conn, json_object *replies, json_object *request)
+{
+    struct json_writer writer;
+    json_object *data, *request_id = NULL, *js_tmp;
+    int raw = 0;
+    const char *msgtext;
+    size_t msglen, size_hint = 256;
+    int ret = 0;
+
+    /* the data of all the replies are the bulk of the message */
+    json_object_object_foreach(replies, sid, reply) {
+        (void)sid;
+        if (json_object_object_get_ex(reply, "data", &data) || json_object_object_get_ex(reply, "patch", &data)) {
+            size_hint += json_object_get_string_len(data) + 64;
+        } else if (json_object_is_type(reply, json_type_string)) {
+            size_hint += json_object_get_string_len(reply);
+        }
+    }
+
+    if (request) {
+        json_object_object_get_ex(request, "request-id", &request_id);
+        if (json_object_object_get_ex(request, "raw-data", &js_tmp) && json_object_get_boolean(js_tmp)) {
+            raw = 1;
+        }
+    }
+
+    /* the envelope is written directly, only the replies themselves are json-c objects */
+    json_writer_init(&writer, size_hint);
+    json_writer_object_start(&writer);
+    if (request_id) {
+        json_writer_key(&writer, "request-id");
+        if (json_object_is_type(request_id, json_type_string)) {
+            json_writer_string_len(&writer, json_object_get_string(request_id), json_object_get_string_len(request_id));
+        } else {
+            json_writer_int(&writer, json_object_get_int64(request_id));
+        }
+    }
+    json_object_object_foreach(replies, key, val) {
+        json_writer_key(&writer, key);
+        write_reply(&writer, val, raw);
+    }
+    json_writer_object_end(&writer);
+
+    msgtext = json_writer_finish(&writer, &msglen);
+    if (msgtext) {
+        DEBUG("Sending message:\n%.*s\n", 1024, msgtext);
+
+        /* replies of concurrently processed requests must not interleave */
+        pthread_mutex_lock(&conn->send_lock);
+        ret = send_framed_message(conn->fd, msgtext, msglen);
+        pthread_mutex_unlock(&conn->send_lock);
+    } else {
+        ERROR("Reply could not be written, it is dropped.");
+    }
+
+    json_writer_clean(&writer);
+    json_object_put(replies);
+    clean_err_reply();
+
+    if (ret) {
+        /* the main loop notices the hang up and closes the connection */
+        shutdown(conn->fd, SHUT_RDWR);
+    }
+}
+
+/**
+ * \brief Worker job processing a single request tagged with "request-id".
+ */
+static void
+request_worker(void *arg)
+{
+    struct request_job *job = (struct request_job *)arg;
+    struct client_conn *conn = job->conn;
+
+    if (!isterminated) {
+        conn_send_replies(conn, process_request(job->request, conn), job->request);
+    }
+
+    json_object_put(job->request);
+    free(job);
+
+    pthread_mutex_lock(&conn->lock);
+    --conn->inflight;
+    conn_resume(conn);
+    pthread_mutex_unlock(&conn->lock);
+    conn_put(conn);
+}
+
+/**
+ * \brief Worker job processing the queued requests of a connection one by one.
+ *
+ * Only one such job exists for a connection at a time, so the replies of
+ * requests without "request-id" are sent in the order the requests were
+ * received. Requests with "request-id" are handed over to separate jobs and
+ * processed concurrently.
+ */
+static void
+conn_worker(void *arg)
+{
+    struct client_conn *conn = (struct client_conn *)arg;
+    struct conn_msg *msg;
+    struct request_job *job;
+    json_object *request, *request_id, *replies;
+
+    while (1) {
+        pthread_mutex_lock(&conn->lock);
+        msg = conn->pending;
+        if (!msg || isterminated) {
+            conn->busy = 0;
+            pthread_mutex_unlock(&conn->lock);
+            break;
+        }
+        conn->pending = msg->next;
+        if (!conn->pending) {
+            conn->pending_last = NULL;
+        }
+        --conn->pending_count;
+        ++conn->inflight;
+        pthread_mutex_unlock(&conn->lock);
+
+        request = msg->request;
+        if (!request) {
+            /* the request was rejected while being received */
+            replies = create_replies();
+            add_reply(replies, create_error_reply(msg->error), 0);
+            conn_send_replies(conn, replies, NULL);
+            request_id = NULL;
+        } else {
+            request_id = request_get_id(request);
+        }
+        free(msg);
+
+        if (request && request_id && (job = malloc(sizeof *job))) {
+            /* process it in parallel with the following requests */
+            job->conn = conn;
+            job->request = request;
+            pthread_mutex_lock(&conn->lock);
+            ++conn->refcount;
+            pthread_mutex_unlock(&conn->lock);
+            if (!worker_pool_submit(workers, request_worker, job)) {
+                continue;
+            }
+            pthread_mutex_lock(&conn->lock);
+            --conn->refcount;
+            pthread_mutex_unlock(&conn->lock);
+            free(job);
+        }
+
+        if (request) {
+            conn_send_replies(conn, process_request(request, conn), request);
+            json_object_put(request);
+        }
+
+        pthread_mutex_lock(&conn->lock);
+        --conn->inflight;
+        conn_resume(conn);
+        pthread_mutex_unlock(&conn->lock);
+    }
+
+    conn_put(conn);
+}
+
+/**
+ * \brief Close all open NETCONF sessions.
+ *
+ * During termination of mod_netconf, it is useful to close all remaining
+ * sessions. This function iterates over the list of sessions and close them
+ * all.
+ */
+static void
+close_all_nc_sessions(void)
+{
+    struct session_with_mutex *locked_session, *next_session;
+    int ret;
+
+    /* get exclusive access to sessions_list (conns) */
+    DEBUG("LOCK wrlock %s", __func__);
+    if ((ret = pthread_rwlock_wrlock(&session_lock)) != 0) {
+        ERROR("Error while locking rwlock: %d (%s)", ret, strerror(ret));
+        return;
+    }
+    next_session = netconf_sessions_list;
+    netconf_sessions_list = NULL;
+    session_table_clean(&session_index);
+
+    /* get exclusive access to sessions_list (conns) */
+    DEBUG("UNLOCK wrlock %s", __func__);
+    if (pthread_rwlock_unlock(&session_lock) != 0) {
+        ERROR("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
+    }
+
+    /* the sessions are not reachable anymore, close them without blocking the others */
+    while (next_session) {
+        locked_session = next_session;
+        next_session = locked_session->next;
+
+        /* close_and_free_session handles locking on its own */
+        DEBUG("Closing NETCONF session %u (SID %u).", locked_session->session_key, locked_session->sid);
+        close_and_free_session(locked_session);
+    }
+}
+
+/**
+ * \brief Close the sessions idle for longer than ACTIVITY_TIMEOUT
+ *
+ * Only the sessions whose timer slots are due are checked under the write
+ * lock, the expired ones are closed after it is released.
+ */
+static void
+check_timeout_and_close(void)
+{
+    struct session_with_mutex *locked_session, *expired;
+    int ret;
+
+    /* get exclusive access to sessions_list (conns) */
+    //DEBUG("LOCK wrlock %s", __func__);
+    if ((ret = pthread_rwlock_wrlock(&session_lock)) != 0) {
+        DEBUG("Error while locking rwlock: %d (%s)", ret, strerror(ret));
+        return;
+    }
+
+    expired = session_timer_expire(&session_idle, time(NULL));
+    for (locked_session = expired; locked_session; locked_session = locked_session->timer_next) {
+        DEBUG("Closing NETCONF session %u (SID %u).", locked_session->session_key, locked_session->sid);
+
+        /* remove it from the list, it is closed once session_lock is released */
+        session_list_remove(locked_session);
+    }
+    //DEBUG("UNLOCK wrlock %s", __func__);
+    if (pthread_rwlock_unlock(&session_lock) != 0) {
+        ERROR("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
+    }
+
+    while (expired) {
+        locked_session = expired;
+        expired = locked_session->timer_next;
+
+        /* close_and_free_session handles locking on its own */
+        close_and_free_session(locked_session);
+    }
+}
+
+/**
+ * \brief Thread closing the idle sessions every ACTIVITY_CHECK_INTERVAL seconds
+ *
+ * Closing a session waits for its dispatcher thread to fail the RPCs in
+ * progress, so it is kept away from the main loop.
+ */
+static void *
+session_reaper(void *UNUSED(arg))
+{
+    struct timespec wakeup;
+
+    pthread_mutex_lock(&reaper_lock);
+    while (!reaper_stop) {
+        clock_gettime(CLOCK_REALTIME, &wakeup);
+        wakeup.tv_sec += ACTIVITY_CHECK_INTERVAL;
+        if (pthread_cond_timedwait(&reaper_cond, &reaper_lock, &wakeup) == ETIMEDOUT) {
+            pthread_mutex_unlock(&reaper_lock);
+            check_timeout_and_close();
+            pthread_mutex_lock(&reaper_lock);
+        }
+    }
+    pthread_mutex_unlock(&reaper_lock);
+    return NULL;
+}
+
+
+/**
+ * \brief Stop serving a frontend connection in the main loop.
+ *
+ * The socket is closed once the worker processing the connection (if any)
+ * releases it.
+ *
+ * \param[in] conn frontend connection
+ * \param[in] drop whether to drop the requests not processed yet, otherwise the
+ * worker still processes them and sends their replies
+ */
+static void
+reactor_close(struct client_conn *conn, int drop)
+{
+    struct conn_msg *msg;
+
+    pthread_mutex_lock(&conn->lock);
+    conn->closed = 1;
+    epoll_ctl(reactor_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    while (drop && (msg = conn->pending)) {
+        conn->pending = msg->next;
+        json_object_put(msg->request);
+        free(msg);
+    }
+    if (drop) {
+        conn->pending_last = NULL;
+        conn->pending_count = 0;
+    }
+    pthread_mutex_unlock(&conn->lock);
+
+    conn_table[conn->fd] = NULL;
+    --conn_count;
+    conn_put(conn);
+}
+
+/**
+ * \brief Accept all pending frontend connections and register them in the main loop.
+ */
+static void
+reactor_accept(int lsock)
+{
+    struct sockaddr_un remote;
+    struct client_conn *conn, **new_table;
+    struct epoll_event ev;
+    socklen_t len;
+    int client, new_size;
+
+    while (1) {
+        len = sizeof(remote);
+        client = accept4(lsock, (struct sockaddr *) &remote, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client == -1) {
+            if (errno == EINTR) {
+                continue;
+            } else if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                ERROR("Accepting mod_netconf client connection failed (%s)", strerror(errno));
+            }
+            return;
+        }
+
+        if (client >= conn_table_size) {
+            new_size = (conn_table_size ? conn_table_size : 64);
+            while (new_size <= client) {
+                new_size *= 2;
+            }
+            new_table = realloc(conn_table, new_size * sizeof *conn_table);
+            if (!new_table) {
+                ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+                close(client);
+                continue;
+            }
+            memset(new_table + conn_table_size, 0, (new_size - conn_table_size) * sizeof *conn_table);
+            conn_table = new_table;
+            conn_table_size = new_size;
+        }
+
+        conn = calloc(1, sizeof *conn);
+        if (!conn) {
+            ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+            close(client);
+            continue;
+        }
+        if (frame_reader_init(&conn->reader, client)) {
+            free(conn);
+            close(client);
+            continue;
+        }
+        conn->fd = client;
+        conn->refcount = 1;
+        pthread_mutex_init(&conn->lock, NULL);
+        pthread_mutex_init(&conn->send_lock, NULL);
+
+        memset(&ev, 0, sizeof ev);
+        ev.events = EPOLLIN;
+        ev.data.fd = client;
+        if (epoll_ctl(reactor_fd, EPOLL_CTL_ADD, client, &ev) == -1) {
+            ERROR("Adding fd %d into epoll failed (%s)", client, strerror(errno));
+            conn_put(conn);
+            continue;
+        }
+        conn_table[client] = conn;
+        ++conn_count;
+        DEBUG("Frontend connection %d accepted", client);
+    }
+}
+
+/**
+ * \brief Read everything available on a frontend connection and queue the complete requests.
+ */
+static void
+reactor_read(struct client_conn *conn)
+{
+    struct conn_msg *msg;
+    struct epoll_event ev;
+    int ret, submit;
+
+    while (1) {
+        pthread_mutex_lock(&conn->lock);
+        if (conn->pending_count + conn->inflight >= CONN_MAX_PENDING) {
+            /* the worker resumes reading once it catches up */
+            memset(&ev, 0, sizeof ev);
+            ev.data.fd = conn->fd;
+            epoll_ctl(reactor_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+            conn->throttled = 1;
+            pthread_mutex_unlock(&conn->lock);
+            return;
+        }
+        pthread_mutex_unlock(&conn->lock);
+
+        ret = frame_reader_read(&conn->reader);
+        if (ret == 0) {
+            return;
+        } else if (ret == -1) {
+            /* EOF or broken framing, nothing more can be read, but the frontend
+             * may have only shut down its sending side and still wait for the replies */
+            reactor_close(conn, !conn->reader.eof);
+            return;
+        }
+
+        msg = malloc(sizeof *msg);
+        if (!msg) {
+            ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+            reactor_close(conn, 1);
+            return;
+        }
+        msg->request = frame_reader_take(&conn->reader, &msg->error);
+        msg->next = NULL;
+
+        pthread_mutex_lock(&conn->lock);
+        if (conn->pending_last) {
+            conn->pending_last->next = msg;
+        } else {
+            conn->pending = msg;
+        }
+        conn->pending_last = msg;
+        ++conn->pending_count;
+        submit = !conn->busy;
+        if (submit) {
+            conn->busy = 1;
+            ++conn->refcount;
+        }
+        pthread_mutex_unlock(&conn->lock);
+
+        if (submit && worker_pool_submit(workers, conn_worker, conn)) {
+            pthread_mutex_lock(&conn->lock);
+            conn->busy = 0;
+            pthread_mutex_unlock(&conn->lock);
+            conn_put(conn);
+            reactor_close(conn, 1);
+            return;
+        }
+    }
+}
+
+/**
+ * \brief Log the current load of the daemon.
+ */
+static void
+reactor_report_stats(void)
+{
+    struct worker_pool_stats stats;
+
+    worker_pool_stats(workers, &stats);
+    INFO("Connections: %u, workers: %u (busy %u), queued jobs: %u (max %u), processed jobs: %llu",
+         conn_count, stats.workers, stats.busy, stats.queued, stats.queued_max, stats.done);
+}
+
+/**
+ * \brief Release the thread-specific resources of a worker thread.
+ */
+static void
+worker_thread_clean(void)
+{
+    free_err_reply();
+    nc_thread_destroy();
+}
+
+/**
+ * \brief Add a file descriptor into the main loop epoll instance.
+ */
+static int
+reactor_add(int fd, uint32_t events)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof ev);
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(reactor_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        ERROR("Adding fd %d into epoll failed (%s)", fd, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * This is actually implementation of NETCONF client
+ * - requests are received from UNIX socket in the predefined format
+ * - results are replied through the same way
+ * - the daemon run as a separate process
+ *
+ */
+static void
+forked_proc(void)
+{
+    struct sockaddr_un local;
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    struct itimerspec tick;
+    uint64_t expirations;
+    int lsock = -1, tfd = -1, fd, i, n;
+    socklen_t len;
+    pthread_rwlockattr_t lock_attrs;
+    #ifdef WITH_NOTIFICATIONS
+    char use_notifications = 0;
+    #endif
+
+#ifdef HAVE_UNIXD_SETUP_CHILD
+    /* change uid and gid of process for security reasons */
+    unixd_setup_child();
 #else
 # ifdef SU_GROUP
     if (strlen(SU_GROUP) > 0) {
@@ -3800,10 +4984,31 @@ forked_proc(void)
         ERROR("Chown on socket file failed (%s).", strerror(errno));
     }
 
+    /* prepare the main loop, all its sources are served as soon as they are ready */
+    if ((reactor_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+        ERROR("Creating epoll instance failed (%s)", strerror(errno));
+        goto error_exit;
+    }
+    if ((tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1) {
+        ERROR("Creating timer failed (%s)", strerror(errno));
+        goto error_exit;
+    }
+    tick.it_interval.tv_sec = REACTOR_TICK;
+    tick.it_interval.tv_nsec = 0;
+    tick.it_value = tick.it_interval;
+    if (timerfd_settime(tfd, 0, &tick, NULL) == -1) {
+        ERROR("Setting timer failed (%s)", strerror(errno));
+        goto error_exit;
+    }
+    fcntl(lsock, F_SETFL, fcntl(lsock, F_GETFL, 0) | O_NONBLOCK);
+    if (reactor_add(lsock, EPOLLIN) || reactor_add(tfd, EPOLLIN)) {
+        goto error_exit;
+    }
+
     /* prepare internal lists */
 
     #ifdef WITH_NOTIFICATIONS
-    if (notification_init() == -1) {
+    if (notification_init(reactor_fd) == -1) {
         ERROR("libwebsockets initialization failed");
         use_notifications = 0;
     } else {
@@ -3833,7 +5038,6 @@ forked_proc(void)
         goto error_exit;
     }
     pthread_mutex_init(&ntf_history_lock, NULL);
-    pthread_mutex_init(&json_lock, NULL);
     DEBUG("Initialization of notification history.");
     if (pthread_key_create(&notif_history_key, NULL) != 0) {
         ERROR("Initialization of notification history failed.");
@@ -3842,68 +5046,78 @@ forked_proc(void)
         ERROR("Initialization of reply key failed.");
     }
 
-    fcntl(lsock, F_SETFL, fcntl(lsock, F_GETFL, 0) | O_NONBLOCK);
+    /* start the threads processing frontend requests */
+    workers = worker_pool_create(worker_count, create_err_reply_p, worker_thread_clean);
+    if (!workers) {
+        ERROR("Starting worker threads failed.");
+        goto error_exit;
+    }
+    DEBUG("Started %u worker threads.", worker_count);
+
+    /* start the thread closing the idle sessions */
+    session_timer_init(&session_idle, ACTIVITY_TIMEOUT, ACTIVITY_CHECK_INTERVAL, time(NULL));
+    if (pthread_create(&reaper_thread, NULL, session_reaper, NULL) != 0) {
+        ERROR("Starting the session reaper thread failed.");
+        goto error_exit;
+    }
+
     while (isterminated == 0) {
-        gettimeofday(&tv, NULL);
-        timediff = (unsigned int)tv.tv_sec - olds;
-        #ifdef WITH_NOTIFICATIONS
-        if (use_notifications == 1) {
-            notification_handle();
-        }
-        #endif
-        if (timediff > ACTIVITY_CHECK_INTERVAL) {
-            check_timeout_and_close();
+        if (report_stats) {
+            report_stats = 0;
+            reactor_report_stats();
         }
 
-        /* open incoming connection if any */
-        len = sizeof(remote);
-        client = accept(lsock, (struct sockaddr *) &remote, &len);
-        if (client == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-            usleep(SLEEP_TIME * 1000);
-            continue;
-        } else if (client == -1 && (errno == EINTR)) {
-            continue;
-        } else if (client == -1) {
-            ERROR("Accepting mod_netconf client connection failed (%s)", strerror(errno));
+        n = epoll_wait(reactor_fd, events, REACTOR_MAX_EVENTS, -1);
+        if (n == -1) {
+            if (errno != EINTR) {
+                ERROR("Waiting for events failed (%s)", strerror(errno));
+            }
             continue;
         }
 
-        /* set client's socket as non-blocking */
-        //fcntl(client, F_SETFL, fcntl(client, F_GETFL, 0) | O_NONBLOCK);
-
-        arg = malloc(sizeof(struct pass_to_thread));
-        arg->client = client;
-        arg->netconf_sessions_list = netconf_sessions_list;
-
-        /* start new thread. It will serve this particular request and then terminate */
-        if ((ret = pthread_create (&ptids[pthread_count], NULL, thread_routine, (void *)arg)) != 0) {
-            ERROR("Creating POSIX thread failed: %d\n", ret);
-        } else {
-            DEBUG("Thread %lu created", ptids[pthread_count]);
-            pthread_count++;
-            ptids = realloc (ptids, sizeof(pthread_t) * (pthread_count+1));
-            ptids[pthread_count] = 0;
-        }
-
-        /* check if some thread already terminated, free some resources by joining it */
-        for (i = 0; i < pthread_count; i++) {
-            if (pthread_tryjoin_np(ptids[i], (void **)&arg) == 0) {
-                DEBUG("Thread %lu joined with retval %p", ptids[i], arg);
-                pthread_count--;
-                if (pthread_count > 0) {
-                    /* place last Thread ID on the place of joined one */
-                    ptids[i] = ptids[pthread_count];
+        for (i = 0; i < n; ++i) {
+            fd = events[i].data.fd;
+            if (fd == lsock) {
+                /* open incoming connections */
+                reactor_accept(lsock);
+            } else if ((fd < conn_table_size) && conn_table[fd]) {
+                if (events[i].events & EPOLLIN) {
+                    reactor_read(conn_table[fd]);
+                } else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                    reactor_close(conn_table[fd], 1);
+                }
+            } else if (fd == tfd) {
+                if (read(tfd, &expirations, sizeof expirations) != sizeof expirations) {
+                    continue;
+                }
+                #ifdef WITH_NOTIFICATIONS
+                if (use_notifications == 1) {
+                    notification_tick();
                 }
+                #endif
+            #ifdef WITH_NOTIFICATIONS
+            } else if (use_notifications == 1) {
+                notification_service_fd(fd, events[i].events);
+            #endif
             }
         }
-        DEBUG("Running %d threads", pthread_count);
     }
 
     DEBUG("mod_netconf terminating...");
-    /* join all threads */
-    for (i = 0; i < pthread_count; i++) {
-        pthread_timedjoin_np(ptids[i], (void **)&arg, &maxtime);
+    /* close all frontend connections and wait at most 5 seconds for the workers to terminate */
+    for (fd = 0; fd < conn_table_size; ++fd) {
+        if (conn_table[fd]) {
+            reactor_close(conn_table[fd], 1);
+        }
     }
+    worker_pool_destroy(workers, 5);
+    free(conn_table);
+
+    pthread_mutex_lock(&reaper_lock);
+    reaper_stop = 1;
+    pthread_cond_signal(&reaper_cond);
+    pthread_mutex_unlock(&reaper_lock);
+    pthread_join(reaper_thread, NULL);
 
     #ifdef WITH_NOTIFICATIONS
     notification_close();
@@ -3919,36 +5133,69 @@ forked_proc(void)
     DEBUG("Exiting from the mod_netconf daemon");
 
     nc_client_destroy();
-    free(ptids);
+    close(tfd);
+    close(reactor_fd);
     close(lsock);
     exit(0);
     return;
 
 error_exit:
     nc_client_destroy();
-    close(lsock);
-    free(ptids);
+    if (tfd > -1) {
+        close(tfd);
+    }
+    if (reactor_fd > -1) {
+        close(reactor_fd);
+    }
+    if (lsock > -1) {
+        close(lsock);
+    }
     return;
 }
 
+/**
+ * \brief Print the command line usage.
+ */
+static void
+print_usage(void)
+{
+    printf("Usage: [--(h)elp] [--(d)aemon] [--(w)orkers <count>] [--(f)anout <count>] [--(c)ache-ttl <seconds>] [socket-path]\n");
+}
+
 int
 main(int argc, char **argv)
 {
     struct sigaction action;
+    char *ptr;
     int i;
 
-    if (argc > 3) {
-        printf("Usage: [--(h)elp] [--(d)aemon] [socket-path]\n");
-        return 1;
-    }
-
     sockname = SOCKET_FILENAME;
     for (i = 1; i < argc; ++i) {
         if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
-            printf("Usage: [--(h)elp] [--(d)aemon] [socket-path]\n");
+            print_usage();
             return 0;
         } else if (!strcmp(argv[i], "-d") || !strcmp(argv[i], "--daemon")) {
             daemonize = 1;
+        } else if (!strcmp(argv[i], "-w") || !strcmp(argv[i], "--workers")) {
+            if ((i + 1 == argc) || !(worker_count = strtoul(argv[++i], &ptr, 10)) || *ptr) {
+                print_usage();
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--fanout")) {
+            if ((i + 1 == argc) || !(fanout_limit = strtoul(argv[++i], &ptr, 10)) || *ptr) {
+                print_usage();
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "-c") || !strcmp(argv[i], "--cache-ttl")) {
+            if ((i + 1 == argc) || !*argv[i + 1]) {
+                print_usage();
+                return 1;
+            }
+            config_cache_ttl = strtoul(argv[++i], &ptr, 10);
+            if (*ptr) {
+                print_usage();
+                return 1;
+            }
         } else {
             sockname = argv[i];
         }
@@ -3967,6 +5214,7 @@ main(int argc, char **argv)
     action.sa_flags = 0;
     sigaction(SIGINT, &action, NULL);
     sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGUSR1, &action, NULL);
 
     action.sa_handler = SIG_IGN;
     sigaction(SIGPIPE, &action, NULL);
@@ -50,10 +50,13 @@
 #define _NETOPEERGUID_H
 
 #include <pthread.h>
+#include <stdint.h>
 #include <json.h>
 #include <syslog.h>
 #include <libyang/libyang.h>
 
+#include "frame_reader.h"
+
 #define UNUSED(x) UNUSED_ ## x __attribute__((__unused__))
 
 /**
@@ -61,6 +64,14 @@
  */
 #define CHECK_AND_FREE(pointer) if (pointer != NULL) { free(pointer); pointer = NULL; }
 
+struct metadata_cache;
+struct config_cache;
+struct flight_group;
+struct snapshot_store;
+struct session_user;
+struct rpc_dispatcher;
+struct data_print_opts;
+
 typedef struct notification {
     time_t eventtime;
     char* content;
@@ -69,30 +80,114 @@ typedef struct notification {
 struct session_with_mutex {
     struct nc_session *session; /**< netconf session */
     unsigned int session_key;    /**< unique session identifier throughout all the sessions */
+    uint32_t sid;                /**< NETCONF session-id assigned by the server */
     notification_t *notifications;
     int notif_count;
     json_object *hello_message;
+    struct metadata_cache *metadata_cache; /**< metadata of the schema nodes of the session context */
+    struct config_cache *config_cache; /**< recent get-config results of the session */
+    struct flight_group *flights; /**< get and get-config requests in progress, joined by identical ones */
+    struct snapshot_store *snapshots; /**< data last sent to the frontends, for delta replies */
+    struct rpc_dispatcher *dispatcher; /**< sends the RPCs of the requests and receives their replies */
     char closed; /**< 0 when session is terminated */
-    time_t last_activity;
+    unsigned int refcount; /**< held by netconf_sessions_list and by the requests using the session */
+    struct session_user *user; /**< user of the session, shares the time of the last activity */
     pthread_mutex_t lock; /**< mutex protecting the session from multiple access */
 
     struct session_with_mutex *prev;
     struct session_with_mutex *next;
+    struct session_with_mutex *key_next; /**< next session in the same bucket of the index by key */
+    struct session_with_mutex *sid_next; /**< next session in the same bucket of the index by session-id */
+    struct session_with_mutex *timer_prev; /**< previous session in the same slot of the idle timer */
+    struct session_with_mutex *timer_next; /**< next session in the same slot of the idle timer */
+    unsigned int timer_slot; /**< slot of the idle timer */
 };
 
-struct pass_to_thread {
-    int client; /**< opened socket */
-    struct session_with_mutex *netconf_sessions_list; /**< ?? */
+/**
+ * \brief Request received from a frontend waiting to be processed.
+ */
+struct conn_msg {
+    json_object *request;   /**< parsed request, NULL if rejected */
+    const char *error;      /**< reason the request was rejected */
+    struct conn_msg *next;
+};
+
+/**
+ * \brief Frontend connection.
+ *
+ * The socket is read only by the main loop, received requests are queued in
+ * the connection and processed in order by a worker thread.
+ */
+struct client_conn {
+    int fd;                         /**< connection socket, closed with the last reference */
+    struct frame_reader reader;     /**< used only by the main loop */
+    pthread_mutex_t send_lock;      /**< serializes replies sent to the socket */
+    pthread_mutex_t lock;           /**< protects the members below */
+    unsigned int refcount;          /**< held by the main loop and by the jobs processing requests */
+    char closed;                    /**< the main loop does not serve the connection anymore */
+    char busy;                      /**< a job processing the queued requests in order is submitted */
+    char throttled;                 /**< reading is suspended because too many requests are queued */
+    struct conn_msg *pending;       /**< queued requests, the oldest first */
+    struct conn_msg *pending_last;  /**< the newest queued request */
+    unsigned int pending_count;     /**< number of queued requests */
+    unsigned int inflight;          /**< number of requests being processed */
+};
+
+/**
+ * \brief Operation of a single request processed on its sessions in parallel.
+ */
+struct fanout {
+    pthread_mutex_t lock;           /**< protects the members below */
+    pthread_cond_t cond;            /**< signalled when all the sessions are processed */
+    unsigned int refcount;          /**< held by the requesting thread and by every helper job */
+    json_object *request;           /**< parsed request, valid until all the sessions are processed, read-only */
+    int operation;                  /**< operation of the request */
+    unsigned int *session_keys;     /**< sessions of the request */
+    json_object **replies;          /**< replies of the sessions */
+    int count;                      /**< number of sessions */
+    int next;                       /**< index of the next session to process */
+    int done;                       /**< number of processed sessions */
+    struct client_conn *conn;       /**< connection to stream the replies to, NULL to collect them */
+    const struct data_print_opts *print_opts; /**< metadata options of data replies */
+};
+
+/**
+ * \brief Request tagged with "request-id", processed independently of the other requests.
+ */
+struct request_job {
+    struct client_conn *conn;       /**< connection the request was received from, holds a reference */
+    json_object *request;           /**< parsed request */
 };
 
-extern pthread_rwlock_t session_lock; /**< mutex protecting netconf_session_list from multiple access errors */
+extern pthread_rwlock_t session_lock; /**< mutex protecting netconf_session_list and session_index from multiple access errors */
 
 extern pthread_key_t err_reply_key;
-extern pthread_mutex_t json_lock;
 extern int daemonize;
 
 json_object *create_error_reply(const char *errmess);
 
+/**
+ * \brief Take a reference to a session, it is freed only after the reference is released by session_put()
+ *
+ * The session must be found under session_lock, the reference keeps it valid
+ * after session_lock is released.
+ */
+void session_ref(struct session_with_mutex *locked_session);
+
+/**
+ * \brief Release a reference to a session, free it with the last one
+ */
+void session_put(struct session_with_mutex *locked_session);
+
+/**
+ * \brief Render the metadata of a schema node as a JSON object
+ * \param[in] node schema node
+ * \param[in] minimal whether to render only the structural metadata
+ * \param[out] len length of the returned text
+ * \return JSON text to be freed by the caller, NULL on error.
+ */
+char *node_metadata_json(const struct lys_node *node, int minimal, size_t *len);
+
 #ifdef DBG
 
 #define DEBUG(...) \
@@ -117,6 +212,14 @@ if (daemonize) { \
     fprintf(stderr, "\n"); \
 }
 
+#define INFO(...) \
+if (daemonize) { \
+    syslog(LOG_INFO, __VA_ARGS__); \
+} else { \
+    fprintf(stderr, __VA_ARGS__); \
+    fprintf(stderr, "\n"); \
+}
+
 #define GETSPEC_ERR_REPLY \
 json_object **err_reply_p = (json_object **) pthread_getspecific(err_reply_key); \
 json_object *err_reply = ((err_reply_p != NULL)?(*err_reply_p):NULL);
@@ -26,6 +26,7 @@
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <sys/queue.h>
+#include <sys/epoll.h>
 #include <fcntl.h>
 #include <pthread.h>
 #include <errno.h>
@@ -37,6 +38,8 @@
 #endif
 
 #include "netopeerguid.h"
+#include "session_table.h"
+#include "rpc_dispatch.h"
 #include "../config.h"
 
 #ifdef TEST_NOTIFICATION_SERVER
@@ -49,9 +52,10 @@ static int max_poll_elements;
 static struct pollfd *pollfds;
 static int *fd_lookup;
 static int count_pollfds;
+static int reactor_fd = -1; /**< epoll instance of the daemon main loop */
 static struct lws_context *context = NULL;
 
-extern struct session_with_mutex *netconf_sessions_list;
+extern struct session_table session_index;
 static pthread_key_t thread_key;
 
 enum demo_protocols {
@@ -240,6 +244,30 @@ debug_print_clb(const char *func, enum lws_callback_reasons reason)
     }
 }
 
+/**
+ * \brief Mirror a change of the libwebsockets poll set into the daemon epoll instance.
+ */
+static int
+reactor_ctl(int op, int fd, int poll_events)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof ev);
+    if (poll_events & POLLIN) {
+        ev.events |= EPOLLIN;
+    }
+    if (poll_events & POLLOUT) {
+        ev.events |= EPOLLOUT;
+    }
+    ev.data.fd = fd;
+
+    if (epoll_ctl(reactor_fd, op, fd, &ev) == -1) {
+        ERROR("notifications: epoll_ctl on fd %d failed (%s)", fd, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
 static int
 callback_http(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t UNUSED(len))
 {
@@ -351,6 +379,9 @@ bail:
             return 1;
         }
 
+        if (reactor_ctl(EPOLL_CTL_ADD, pa->fd, pa->events)) {
+            return 1;
+        }
         fd_lookup[pa->fd] = count_pollfds;
         pollfds[count_pollfds].fd = pa->fd;
         pollfds[count_pollfds].events = pa->events;
@@ -358,6 +389,7 @@ bail:
         break;
 
     case LWS_CALLBACK_DEL_POLL_FD:
+        reactor_ctl(EPOLL_CTL_DEL, pa->fd, 0);
         if (!--count_pollfds)
             break;
         m = fd_lookup[pa->fd];
@@ -367,6 +399,7 @@ bail:
         break;
 
     case LWS_CALLBACK_CHANGE_MODE_POLL_FD:
+        reactor_ctl(EPOLL_CTL_MOD, pa->fd, pa->events);
         pollfds[fd_lookup[pa->fd]].events = pa->events;
         break;
 
@@ -395,28 +428,49 @@ struct per_session_data__notif_client {
 static struct session_with_mutex *
 get_ncsession_from_sid(const char *session_id)
 {
-    struct session_with_mutex *locked_session = NULL;
-
     if (session_id == NULL) {
         return (NULL);
     }
 
-    for (locked_session = netconf_sessions_list;
-         locked_session && (nc_session_get_id(locked_session->session) == (unsigned)atoi(session_id));
-         locked_session = locked_session->next);
+    return session_table_find_sid(&session_index, (uint32_t)atoi(session_id));
+}
+
+/**
+ * \brief Get a reference to a session by its NETCONF session-id, session_lock is held only for the lookup
+ *
+ * \return Session to be released by session_put(), NULL if there is no such session.
+ */
+static struct session_with_mutex *
+session_get_by_sid(const char *session_id)
+{
+    struct session_with_mutex *locked_session;
+
+    if (pthread_rwlock_rdlock(&session_lock) != 0) {
+        DEBUG("Error while locking rwlock: %d (%s)", errno, strerror(errno));
+        return NULL;
+    }
+    locked_session = get_ncsession_from_sid(session_id);
+    if (locked_session) {
+        session_ref(locked_session);
+    }
+    if (pthread_rwlock_unlock(&session_lock) != 0) {
+        DEBUG("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
+    }
     return locked_session;
 }
 
 /* rpc parameter is freed after the function call */
 static int
-send_recv_process(struct nc_session *session, const char* UNUSED(operation), struct nc_rpc* rpc)
+send_recv_process(struct session_with_mutex *locked_session, const char* UNUSED(operation), struct nc_rpc* rpc)
 {
+    struct nc_session *session = locked_session->session;
     struct nc_reply *reply = NULL;
     char *data = NULL;
     int ret = EXIT_SUCCESS;
 
     /* send the request and get the reply */
-    switch (netconf_send_recv_timed(session, rpc, 50000, 0, &reply)) {
+    /* the session is read only by its dispatcher */
+    switch (rpc_dispatcher_call(locked_session->dispatcher, rpc, 50000, 0, &reply)) {
     case NC_MSG_ERROR:
         if (nc_session_get_status(session) != NC_STATUS_RUNNING) {
             ERROR("notifications: receiving rpc-reply failed.");
@@ -575,7 +629,7 @@ notif_subscribe(struct session_with_mutex *locked_session, const char *session_i
 
     DEBUG("Send NC subscribe.");
     create_err_reply_p();
-    if (send_recv_process(session, "subscribe", rpc) != 0) {
+    if (send_recv_process(locked_session, "subscribe", rpc) != 0) {
         ERROR("Subscription RPC failed.");
         goto operation_failed;
     }
@@ -627,33 +681,17 @@ callback_notification(struct lws *wsi, enum lws_callback_reasons reason, void *u
             return 0;
         }
         //DEBUG("Callback server writeable.");
-        //DEBUG("lock session lock.");
-        if (pthread_rwlock_wrlock(&session_lock) != 0) {
-            DEBUG("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-            return -1;
-        }
-        //DEBUG("get session_with_mutex for %s.", pss->session_id);
-        struct session_with_mutex *ls = get_ncsession_from_sid(pss->session_id);
+        struct session_with_mutex *ls = session_get_by_sid(pss->session_id);
         if (ls == NULL) {
             DEBUG("notification: session not found");
-            if (pthread_rwlock_unlock (&session_lock) != 0) {
-                DEBUG("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-                return -1;
-            }
             return -1;
         }
         pthread_mutex_lock(&ls->lock);
-        if (pthread_rwlock_unlock(&session_lock) != 0) {
-            DEBUG("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-        }
 
         //DEBUG("check for closed session.");
         if (ls->closed == 1) {
-            DEBUG("unlock session key.");
-            if (pthread_rwlock_unlock (&session_lock) != 0) {
-                DEBUG("Error while unlocking unlock: %d (%s)", errno, strerror(errno));
-                return -1;
-            }
+            pthread_mutex_unlock(&ls->lock);
+            session_put(ls);
             return -1;
         }
         //DEBUG("lock private lock.");
@@ -665,11 +703,9 @@ callback_notification(struct lws *wsi, enum lws_callback_reasons reason, void *u
                 notif = ls->notifications + i - 1;
 
                 n = 0;
-                pthread_mutex_lock(&json_lock);
                 json_object *notif_json = json_object_new_object();
                 json_object_object_add(notif_json, "eventtime", json_object_new_int64(notif->eventtime));
                 json_object_object_add(notif_json, "content", json_object_new_string(notif->content));
-                pthread_mutex_unlock(&json_lock);
 
                 const char *msgtext = json_object_to_json_string(notif_json);
 
@@ -682,9 +718,7 @@ callback_notification(struct lws *wsi, enum lws_callback_reasons reason, void *u
                     break;
                 }
 
-                pthread_mutex_lock(&json_lock);
                 json_object_put(notif_json);
-                pthread_mutex_unlock(&json_lock);
                 free(notif->content);
             }
             ls->notif_count = 0;
@@ -698,7 +732,7 @@ callback_notification(struct lws *wsi, enum lws_callback_reasons reason, void *u
         if (pthread_mutex_unlock(&ls->lock) != 0) {
             DEBUG("notification: cannot unlock session");
         }
-        //DEBUG("unlock session lock");
+        session_put(ls);
 
         if (m < n) {
             DEBUG("ERROR %d writing to di socket.", n);
@@ -722,35 +756,22 @@ callback_notification(struct lws *wsi, enum lws_callback_reasons reason, void *u
             sscanf(sid_end, "%d %d", (int *) &start, (int *) &stop);
             DEBUG("notification: SID (%s) from (%s) (%i,%i)", pss->session_id, (char *) in, (int) start, (int) stop);
 
-            DEBUG("lock session lock");
-            if (pthread_rwlock_rdlock (&session_lock) != 0) {
-                DEBUG("Error while locking rwlock: %d (%s)", errno, strerror(errno));
-                return -1;
-            }
             DEBUG("get session with ID (%s)", pss->session_id);
-            struct session_with_mutex *ls = get_ncsession_from_sid(pss->session_id);
+            struct session_with_mutex *ls = session_get_by_sid(pss->session_id);
             if (ls == NULL) {
                 DEBUG("notification: session_id not found (%s)", pss->session_id);
-                DEBUG("unlock session lock");
-                if (pthread_rwlock_unlock (&session_lock) != 0) {
-                    DEBUG("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-                }
                 DEBUG("Close notification client");
                 return -1;
             }
             DEBUG("lock private lock");
             pthread_mutex_lock(&ls->lock);
 
-            DEBUG("unlock session lock");
-            if (pthread_rwlock_unlock (&session_lock) != 0) {
-                DEBUG("Error while unlocking rwlock: %d (%s)", errno, strerror(errno));
-            }
-
             DEBUG("Found session to subscribe notif.");
             if (ls->closed == 1) {
                 DEBUG("session already closed - handle no notification");
                 DEBUG("unlock private lock");
                 pthread_mutex_unlock(&ls->lock);
+                session_put(ls);
                 DEBUG("Close notification client");
                 return -1;
             }
@@ -758,15 +779,18 @@ callback_notification(struct lws *wsi, enum lws_callback_reasons reason, void *u
                 DEBUG("notification: already subscribed");
                 DEBUG("unlock private lock");
                 pthread_mutex_unlock(&ls->lock);
+                session_put(ls);
                 /* do not close client, only do not subscribe again */
                 return 0;
             }
             DEBUG("notification: prepare to subscribe stream");
-            DEBUG("unlock session lock");
+            DEBUG("unlock private lock");
             pthread_mutex_unlock(&ls->lock);
 
-            /* notif_subscribe locks on its own */
-            return notif_subscribe(ls, pss->session_id, (time_t) start, (time_t) stop);
+            /* notif_subscribe locks on its own, the reference keeps the session valid meanwhile */
+            n = notif_subscribe(ls, pss->session_id, (time_t) start, (time_t) stop);
+            session_put(ls);
+            return n;
         }
         if (len < 6)
             break;
@@ -822,7 +846,7 @@ static struct lws_protocols protocols[] = {
  * initialization of notification module
  */
 int
-notification_init(void)
+notification_init(int epfd)
 {
     char cert_path[1024], key_path[1024];
     struct lws_context_creation_info info;
@@ -835,9 +859,10 @@ notification_init(void)
     lws_set_log_level(debug_level, lwsl_emit_syslog);
 
     DEBUG("Initialization of libwebsocket");
+    reactor_fd = epfd;
     max_poll_elements = getdtablesize();
-    pollfds = malloc(max_poll_elements * sizeof (struct pollfd));
-    fd_lookup = malloc(max_poll_elements * sizeof (int));
+    pollfds = calloc(max_poll_elements, sizeof (struct pollfd));
+    fd_lookup = calloc(max_poll_elements, sizeof (int));
     if (pollfds == NULL || fd_lookup == NULL) {
         ERROR("notifications: Out of memory pollfds=%d\n", max_poll_elements);
         return -1;
@@ -882,73 +907,63 @@ notification_close(void)
 }
 
 
-/**
- * \brief send notification if any
- * \return < 0 on error
- */
 int
-notification_handle()
+notification_owns_fd(int fd)
 {
-    static struct timeval tv;
-    static unsigned int olds = 0;
-    int n = 0, fd_pos;
+    int idx;
 
-    gettimeofday(&tv, NULL);
+    if ((fd < 0) || (fd >= max_poll_elements)) {
+        return 0;
+    }
+    idx = fd_lookup[fd];
+    return ((idx >= 0) && (idx < count_pollfds) && (pollfds[idx].fd == fd));
+}
 
-    /*
-     * This provokes the LWS_CALLBACK_SERVER_WRITEABLE for every
-     * live websocket connection using the DUMB_INCREMENT protocol,
-     * as soon as it can take more packets (usually immediately)
-     */
+int
+notification_service_fd(int fd, int events)
+{
+    struct pollfd *pfd;
 
-    if (((unsigned int)tv.tv_sec - olds) > 0) {
-        lws_callback_on_writable_all_protocol(context, &protocols[PROTOCOL_NOTIFICATION]);
-        olds = tv.tv_sec;
+    if (!notification_owns_fd(fd)) {
+        return 0;
     }
+    pfd = &pollfds[fd_lookup[fd]];
 
-    /*
-     * this represents an existing server's single poll action
-     * which also includes libwebsocket sockets
-     */
-
-    n = poll(pollfds, count_pollfds, 50);
-    if (n < 0) {
-        return n;
+    pfd->revents = 0;
+    if (events & EPOLLIN) {
+        pfd->revents |= POLLIN;
+    }
+    if (events & EPOLLOUT) {
+        pfd->revents |= POLLOUT;
+    }
+    if (events & EPOLLERR) {
+        pfd->revents |= POLLERR;
+    }
+    if (events & EPOLLHUP) {
+        pfd->revents |= POLLHUP;
     }
 
-    if (n) {
-        for (n = 0; n < count_pollfds; n++) {
-            if (pollfds[n].revents & POLLHUP) {
-                ERROR("notifications: poll pipe closed");
-                if (--count_pollfds) {
-                    fd_pos = fd_lookup[pollfds[n].fd];
-                    pollfds[fd_pos] = pollfds[count_pollfds];
-                    fd_lookup[pollfds[count_pollfds].fd] = fd_pos;
-                }
-                return -1;
-            } else if (pollfds[n].revents & POLLERR) {
-                ERROR("notifications: poll pipe error");
-                if (--count_pollfds) {
-                    fd_pos = fd_lookup[pollfds[n].fd];
-                    pollfds[fd_pos] = pollfds[count_pollfds];
-                    fd_lookup[pollfds[count_pollfds].fd] = fd_pos;
-                }
-                return -1;
-            } else if (pollfds[n].revents & (POLLIN | POLLOUT)) {
-                /*
-                 * returns immediately if the fd does not
-                 * match anything under libwebsockets
-                 * control
-                 */
-                if (lws_service_fd(context, &pollfds[n]) < 0) {
-                    return 1;
-                }
-            }
-        }
+    /* libwebsockets closes the connection on HUP/ERR on its own (and removes it via LWS_CALLBACK_DEL_POLL_FD) */
+    if (lws_service_fd(context, pfd) < 0) {
+        return -1;
     }
     return 0;
 }
 
+void
+notification_tick(void)
+{
+    /*
+     * This provokes the LWS_CALLBACK_SERVER_WRITEABLE for every
+     * live websocket connection using the notification protocol,
+     * as soon as it can take more packets (usually immediately)
+     */
+    lws_callback_on_writable_all_protocol(context, &protocols[PROTOCOL_NOTIFICATION]);
+
+    /* let libwebsockets process its timeouts */
+    lws_service_fd(context, NULL);
+}
+
 #endif
 
 
@@ -957,14 +972,23 @@ notification_handle()
 int
 main(int argc, char **argv)
 {
-    if (notification_init(NULL, NULL) == -1) {
+    struct epoll_event events[16];
+    int epfd, n, i;
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if ((epfd == -1) || (notification_init(epfd) == -1)) {
         fprintf(stderr, "Error during initialization\n");
         return 1;
     }
     while (!force_exit) {
-        notification_handle();
+        n = epoll_wait(epfd, events, 16, 1000);
+        for (i = 0; i < n; ++i) {
+            notification_service_fd(events[i].data.fd, events[i].events);
+        }
+        notification_tick();
     }
     notification_close();
+    close(epfd);
 }
 #endif
 #endif
@@ -54,15 +54,30 @@ typedef struct s {} server_rec;
 
 /**
  * \brief Notification module initialization
+ * \param[in] epfd epoll instance of the daemon main loop, libwebsockets sockets are registered into it
  * \return 0 on success
  */
-int notification_init();
+int notification_init(int epfd);
 
 /**
- * \brief Handle method - passes execution into the libwebsocket library
+ * \brief Check whether the socket is served by the notification module
+ * \param[in] fd socket from the daemon epoll instance
+ * \return 1 if the socket belongs to libwebsockets, 0 otherwise
+ */
+int notification_owns_fd(int fd);
+
+/**
+ * \brief Handle readiness of a socket - passes execution into the libwebsocket library
+ * \param[in] fd socket reported by epoll_wait()
+ * \param[in] events epoll events reported for the socket
  * \return 0 on success
  */
-int notification_handle();
+int notification_service_fd(int fd, int events);
+
+/**
+ * \brief Periodic work of the notification module, to be called every second
+ */
+void notification_tick(void);
 
 /**
  * \brief Notification module finalization
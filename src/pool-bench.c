@@ -0,0 +1,214 @@
+/*!
+ * \file pool-bench.c
+ * \brief Benchmark of parallel JSON processing by the worker threads
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+/*
+ * Worker threads send DATA replies of get requests the way the daemon does -
+ * the request is parsed, the printed data are wrapped by create_data_reply()
+ * and conn_send_replies() writes the reply envelope (write_reply()) and sends
+ * it to a frontend connection. The daemon is compiled in, so its static
+ * functions are used as they are. Every pool size runs twice, once with each
+ * job holding a single global mutex as all the json-c calls used to (json_lock)
+ * and once as the daemon works now.
+ */
+#define main netopeerguid_main
+#include "netopeerguid.c"
+#undef main
+
+#include <err.h>
+
+static const char *request_text = "{\"type\": 6, \"sessions\": [1], \"strict\": false, \"request-id\": 42}";
+static char *data_text;
+
+static pthread_mutex_t json_lock = PTHREAD_MUTEX_INITIALIZER;
+static int use_json_lock;
+
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int done;
+
+static void
+get_job(void *arg)
+{
+    struct client_conn *conn = arg;
+    json_object *request, *replies;
+
+    if (use_json_lock) {
+        pthread_mutex_lock(&json_lock);
+    }
+
+    request = json_tokener_parse(request_text);
+    replies = create_replies();
+    add_reply(replies, create_data_reply(data_text), 1);
+    conn_send_replies(conn, replies, request);
+    json_object_put(request);
+
+    if (use_json_lock) {
+        pthread_mutex_unlock(&json_lock);
+    }
+
+    pthread_mutex_lock(&done_lock);
+    ++done;
+    pthread_cond_signal(&done_cond);
+    pthread_mutex_unlock(&done_lock);
+}
+
+/* printed get data with an interface list */
+static char *
+bench_data(unsigned int entries)
+{
+    char *data;
+    size_t len;
+    unsigned int i;
+
+    data = malloc(64 + entries * 128);
+    if (!data) {
+        errx(1, "memory allocation failed");
+    }
+    len = sprintf(data, "{\"ietf-interfaces:interfaces\":{\"interface\":[");
+    for (i = 0; i < entries; ++i) {
+        len += sprintf(data + len, "%s{\"name\":\"eth%u\",\"enabled\":%s,\"mtu\":%u,"
+                       "\"description\":\"uplink to the \\\"core\\\" router\"}", i ? "," : "", i,
+                       (i % 2) ? "true" : "false", 1500 + i);
+    }
+    strcpy(data + len, "]}}");
+    return data;
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* every worker sends to a connection of its own, replies are discarded */
+static double
+run(unsigned int workers_num, unsigned int jobs)
+{
+    struct worker_pool *pool;
+    struct client_conn *conns;
+    unsigned int i;
+    double start, secs;
+
+    conns = calloc(workers_num, sizeof *conns);
+    for (i = 0; i < workers_num; ++i) {
+        if ((conns[i].fd = open("/dev/null", O_WRONLY)) == -1) {
+            err(1, "open");
+        }
+        pthread_mutex_init(&conns[i].send_lock, NULL);
+    }
+    if (!(pool = worker_pool_create(workers_num, create_err_reply_p, worker_thread_clean))) {
+        errx(1, "worker_pool_create failed");
+    }
+
+    done = 0;
+    start = now();
+    for (i = 0; i < jobs; ++i) {
+        if (worker_pool_submit(pool, get_job, &conns[i % workers_num])) {
+            errx(1, "worker_pool_submit failed");
+        }
+    }
+    pthread_mutex_lock(&done_lock);
+    while (done < jobs) {
+        pthread_cond_wait(&done_cond, &done_lock);
+    }
+    pthread_mutex_unlock(&done_lock);
+    secs = now() - start;
+
+    worker_pool_destroy(pool, 10);
+    for (i = 0; i < workers_num; ++i) {
+        pthread_mutex_destroy(&conns[i].send_lock);
+        close(conns[i].fd);
+    }
+    free(conns);
+    return jobs / secs;
+}
+
+/* doubles the workers, the last step is max_workers itself; 0 when done */
+static unsigned int
+next_workers(unsigned int workers_num, unsigned int max_workers)
+{
+    if (workers_num == max_workers) {
+        return 0;
+    }
+    return (workers_num * 2 < max_workers) ? workers_num * 2 : max_workers;
+}
+
+int
+main(int argc, char *argv[])
+{
+    unsigned int workers_num, max_workers, jobs, entries;
+    double base[2] = {0, 0}, rate[2];
+
+    if (argc > 4) {
+        fprintf(stderr, "Usage: %s [max-workers [jobs [entries]]]\n", argv[0]);
+        return 2;
+    }
+    max_workers = (argc > 1) ? strtoul(argv[1], NULL, 10) : (unsigned int)sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = (argc > 2) ? strtoul(argv[2], NULL, 10) : 2000;
+    entries = (argc > 3) ? strtoul(argv[3], NULL, 10) : 500;
+    if (!max_workers || !jobs) {
+        errx(2, "invalid parameters");
+    }
+
+    if (pthread_key_create(&err_reply_key, NULL) != 0) {
+        errx(1, "pthread_key_create failed");
+    }
+    data_text = bench_data(entries);
+
+    printf("%u get replies of %zu bytes of data\n", jobs, strlen(data_text));
+    printf("%8s %16s %8s %16s %8s\n", "workers", "json_lock job/s", "speedup", "per-thread job/s", "speedup");
+    for (workers_num = 1; workers_num; workers_num = next_workers(workers_num, max_workers)) {
+        for (use_json_lock = 1; use_json_lock >= 0; --use_json_lock) {
+            rate[use_json_lock] = run(workers_num, jobs);
+            if (workers_num == 1) {
+                base[use_json_lock] = rate[use_json_lock];
+            }
+        }
+        printf("%8u %16.0f %8.2f %16.0f %8.2f\n", workers_num, rate[1], rate[1] / base[1], rate[0],
+               rate[0] / base[0]);
+    }
+
+    free(data_text);
+    return 0;
+}
@@ -0,0 +1,410 @@
+/*!
+ * \file rpc_dispatch.c
+ * \brief Dispatcher of the RPCs of a NETCONF session
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <nc_client.h>
+
+#include "netopeerguid.h"
+#include "rpc_dispatch.h"
+
+/** \brief Timeout of a single receive in milliseconds, RPCs submitted meanwhile are sent after it */
+#define RPC_DISPATCH_POLL 10
+
+/**
+ * \brief RPC submitted to a dispatcher, owned by the waiting caller.
+ */
+struct rpc_call {
+    struct nc_rpc *rpc;             /**< RPC to send */
+    int strict;                     /**< whether to parse the reply strictly */
+    int timeout;                    /**< timeout of the call in milliseconds */
+    uint64_t deadline;              /**< time the call fails at, 0 for none */
+    uint64_t msgid;                 /**< message-id of the sent RPC */
+    NC_MSG_TYPE result;             /**< result of the call */
+    struct nc_reply *reply;         /**< received reply */
+    json_object *err;               /**< errors reported by libnetconf for the call */
+    int done;                       /**< the call is finished, the dispatcher does not use it anymore */
+    struct rpc_call *next;
+};
+
+struct rpc_dispatcher {
+    struct nc_session *session;     /**< NETCONF session, read and written only by the thread */
+    pthread_t thread;               /**< thread sending the RPCs and receiving the replies */
+    pthread_mutex_t lock;           /**< protects the members below */
+    pthread_cond_t wakeup;          /**< signalled for the thread when there is a call to send or it should stop */
+    pthread_cond_t done;            /**< signalled for the callers when a call is finished or the thread leaves the session */
+    struct rpc_call *queued;        /**< calls waiting to be sent, the oldest first */
+    struct rpc_call *queued_last;   /**< the newest call waiting to be sent */
+    struct rpc_call *sent;          /**< calls waiting for their replies, in the order they were sent */
+    struct rpc_call *sent_last;     /**< the last call sent */
+    unsigned int paused;            /**< number of callers using the session themselves, no RPC is sent meanwhile */
+    int busy;                       /**< the thread is sending or receiving on the session */
+    int stop;                       /**< the thread is asked to terminate */
+    int stopped;                    /**< the thread was joined */
+};
+
+/**
+ * \brief Current monotonic time in milliseconds.
+ */
+static uint64_t
+rpc_dispatch_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * \brief Take the errors reported by libnetconf in the dispatcher thread.
+ */
+static json_object *
+rpc_dispatch_errors(void)
+{
+    GETSPEC_ERR_REPLY
+
+    if (err_reply_p) {
+        *err_reply_p = NULL;
+    }
+    return err_reply;
+}
+
+/**
+ * \brief Finish a call and wake its caller, the lock of the dispatcher must be held.
+ */
+static void
+rpc_call_finish(struct rpc_dispatcher *dispatcher, struct rpc_call *call, NC_MSG_TYPE result, struct nc_reply *reply,
+                json_object *err)
+{
+    call->result = result;
+    call->reply = reply;
+    call->err = err;
+    call->done = 1;
+    pthread_cond_broadcast(&dispatcher->done);
+}
+
+/**
+ * \brief Fail all the calls of a list, the lock of the dispatcher must be held.
+ *
+ * Every call gets an error reply, its caller must not take the failure for an
+ * error already reported by libnetconf.
+ */
+static void
+rpc_call_fail_all(struct rpc_dispatcher *dispatcher, struct rpc_call **list, struct rpc_call **last,
+                  const char *errmsg)
+{
+    struct rpc_call *call;
+
+    while ((call = *list)) {
+        *list = call->next;
+        rpc_call_finish(dispatcher, call, NC_MSG_ERROR, NULL, create_error_reply(errmsg));
+    }
+    *last = NULL;
+}
+
+/**
+ * \brief Fail the sent calls past their deadline, the lock of the dispatcher must be held.
+ *
+ * Their replies are dropped when they arrive.
+ */
+static void
+rpc_call_expire(struct rpc_dispatcher *dispatcher)
+{
+    struct rpc_call *call, *prev = NULL, *next;
+    uint64_t now = rpc_dispatch_now();
+
+    for (call = dispatcher->sent; call; call = next) {
+        next = call->next;
+        if (!call->deadline || (call->deadline > now)) {
+            prev = call;
+            continue;
+        }
+
+        if (prev) {
+            prev->next = next;
+        } else {
+            dispatcher->sent = next;
+        }
+        if (dispatcher->sent_last == call) {
+            dispatcher->sent_last = prev;
+        }
+        rpc_call_finish(dispatcher, call, NC_MSG_WOULDBLOCK, NULL, NULL);
+    }
+}
+
+/**
+ * \brief Note the thread left the session, the lock of the dispatcher must be held.
+ */
+static void
+rpc_dispatch_idle(struct rpc_dispatcher *dispatcher)
+{
+    dispatcher->busy = 0;
+    if (dispatcher->paused) {
+        pthread_cond_broadcast(&dispatcher->done);
+    }
+}
+
+static void *
+rpc_dispatch_thread(void *arg)
+{
+    struct rpc_dispatcher *dispatcher = arg;
+    struct rpc_call *call;
+    struct nc_reply *reply;
+    json_object *err;
+    NC_MSG_TYPE msgt;
+
+    /* libnetconf errors are collected per thread */
+    create_err_reply_p();
+
+    pthread_mutex_lock(&dispatcher->lock);
+    while (!dispatcher->stop) {
+        if (!dispatcher->paused && (call = dispatcher->queued)) {
+            /* send the RPCs first, their replies are received in order anyway */
+            dispatcher->queued = call->next;
+            if (!dispatcher->queued) {
+                dispatcher->queued_last = NULL;
+            }
+            call->next = NULL;
+            dispatcher->busy = 1;
+            pthread_mutex_unlock(&dispatcher->lock);
+
+            msgt = nc_send_rpc(dispatcher->session, call->rpc, call->timeout, &call->msgid);
+            err = rpc_dispatch_errors();
+
+            pthread_mutex_lock(&dispatcher->lock);
+            rpc_dispatch_idle(dispatcher);
+            if (msgt != NC_MSG_RPC) {
+                rpc_call_finish(dispatcher, call, msgt, NULL, err);
+            } else {
+                json_object_put(err);
+                if (dispatcher->sent_last) {
+                    dispatcher->sent_last->next = call;
+                } else {
+                    dispatcher->sent = call;
+                }
+                dispatcher->sent_last = call;
+            }
+            continue;
+        }
+
+        if (!(call = dispatcher->sent)) {
+            pthread_cond_wait(&dispatcher->wakeup, &dispatcher->lock);
+            continue;
+        }
+
+        /* the call stays in the list, only this thread removes it or the caller waits for it */
+        dispatcher->busy = 1;
+        pthread_mutex_unlock(&dispatcher->lock);
+
+        reply = NULL;
+        msgt = nc_recv_reply(dispatcher->session, call->rpc, call->msgid, RPC_DISPATCH_POLL,
+                             (call->strict ? LYD_OPT_STRICT : 0), &reply);
+        err = rpc_dispatch_errors();
+
+        pthread_mutex_lock(&dispatcher->lock);
+        rpc_dispatch_idle(dispatcher);
+        switch (msgt) {
+        case NC_MSG_WOULDBLOCK:
+        case NC_MSG_NOTIF:
+            /* nothing for the call yet */
+            json_object_put(err);
+            break;
+        case NC_MSG_REPLY_ERR_MSGID:
+            /* reply of a call that already failed on its deadline */
+            DEBUG("Dropping a reply with an unexpected message-id.");
+            nc_reply_free(reply);
+            json_object_put(err);
+            break;
+        default:
+            /* the reply or the error receiving it */
+            dispatcher->sent = call->next;
+            if (!dispatcher->sent) {
+                dispatcher->sent_last = NULL;
+            }
+            rpc_call_finish(dispatcher, call, msgt, reply, err);
+            if ((msgt == NC_MSG_ERROR) && (nc_session_get_status(dispatcher->session) != NC_STATUS_RUNNING)) {
+                ERROR("NETCONF session broken, failing its RPCs in progress.");
+                rpc_call_fail_all(dispatcher, &dispatcher->sent, &dispatcher->sent_last, "NETCONF session broken.");
+            }
+            break;
+        }
+        rpc_call_expire(dispatcher);
+    }
+
+    rpc_call_fail_all(dispatcher, &dispatcher->queued, &dispatcher->queued_last, "Session closed.");
+    rpc_call_fail_all(dispatcher, &dispatcher->sent, &dispatcher->sent_last, "Session closed.");
+    pthread_mutex_unlock(&dispatcher->lock);
+
+    free_err_reply();
+    return NULL;
+}
+
+struct rpc_dispatcher *
+rpc_dispatcher_new(struct nc_session *session)
+{
+    struct rpc_dispatcher *dispatcher;
+
+    dispatcher = calloc(1, sizeof *dispatcher);
+    if (!dispatcher) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        return NULL;
+    }
+    dispatcher->session = session;
+    pthread_mutex_init(&dispatcher->lock, NULL);
+    pthread_cond_init(&dispatcher->wakeup, NULL);
+    pthread_cond_init(&dispatcher->done, NULL);
+
+    if (pthread_create(&dispatcher->thread, NULL, rpc_dispatch_thread, dispatcher) != 0) {
+        ERROR("Starting the RPC dispatcher thread failed.");
+        pthread_cond_destroy(&dispatcher->done);
+        pthread_cond_destroy(&dispatcher->wakeup);
+        pthread_mutex_destroy(&dispatcher->lock);
+        free(dispatcher);
+        return NULL;
+    }
+    return dispatcher;
+}
+
+NC_MSG_TYPE
+rpc_dispatcher_call(struct rpc_dispatcher *dispatcher, struct nc_rpc *rpc, int timeout, int strict,
+                    struct nc_reply **reply)
+{
+    struct rpc_call call;
+
+    memset(&call, 0, sizeof call);
+    call.rpc = rpc;
+    call.strict = strict;
+    call.timeout = timeout;
+    if (timeout >= 0) {
+        call.deadline = rpc_dispatch_now() + timeout;
+    }
+
+    pthread_mutex_lock(&dispatcher->lock);
+    if (dispatcher->stop) {
+        pthread_mutex_unlock(&dispatcher->lock);
+        call.result = NC_MSG_ERROR;
+        call.err = create_error_reply("Session closed.");
+        goto finish;
+    }
+    if (dispatcher->queued_last) {
+        dispatcher->queued_last->next = &call;
+    } else {
+        dispatcher->queued = &call;
+    }
+    dispatcher->queued_last = &call;
+    pthread_cond_signal(&dispatcher->wakeup);
+
+    while (!call.done) {
+        pthread_cond_wait(&dispatcher->done, &dispatcher->lock);
+    }
+    pthread_mutex_unlock(&dispatcher->lock);
+
+finish:
+    if (call.err) {
+        /* as if libnetconf reported them in this thread */
+        GETSPEC_ERR_REPLY
+        if (err_reply_p && !err_reply) {
+            *err_reply_p = call.err;
+        } else {
+            json_object_put(call.err);
+        }
+    }
+
+    *reply = call.reply;
+    return call.result;
+}
+
+void
+rpc_dispatcher_pause(struct rpc_dispatcher *dispatcher)
+{
+    pthread_mutex_lock(&dispatcher->lock);
+    ++dispatcher->paused;
+
+    /* the replies of the RPCs already sent are still received (or the calls expire) */
+    while (dispatcher->sent || dispatcher->busy) {
+        pthread_cond_wait(&dispatcher->done, &dispatcher->lock);
+    }
+    pthread_mutex_unlock(&dispatcher->lock);
+}
+
+void
+rpc_dispatcher_resume(struct rpc_dispatcher *dispatcher)
+{
+    pthread_mutex_lock(&dispatcher->lock);
+    if (!--dispatcher->paused) {
+        pthread_cond_signal(&dispatcher->wakeup);
+    }
+    pthread_mutex_unlock(&dispatcher->lock);
+}
+
+void
+rpc_dispatcher_stop(struct rpc_dispatcher *dispatcher)
+{
+    pthread_mutex_lock(&dispatcher->lock);
+    if (dispatcher->stopped) {
+        pthread_mutex_unlock(&dispatcher->lock);
+        return;
+    }
+    dispatcher->stop = 1;
+    dispatcher->stopped = 1;
+    pthread_cond_signal(&dispatcher->wakeup);
+    pthread_mutex_unlock(&dispatcher->lock);
+
+    pthread_join(dispatcher->thread, NULL);
+}
+
+void
+rpc_dispatcher_free(struct rpc_dispatcher *dispatcher)
+{
+    if (!dispatcher) {
+        return;
+    }
+
+    rpc_dispatcher_stop(dispatcher);
+    pthread_cond_destroy(&dispatcher->done);
+    pthread_cond_destroy(&dispatcher->wakeup);
+    pthread_mutex_destroy(&dispatcher->lock);
+    free(dispatcher);
+}
@@ -0,0 +1,122 @@
+/*!
+ * \file rpc_dispatch.h
+ * \brief Dispatcher of the RPCs of a NETCONF session
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#ifndef _RPC_DISPATCH_H
+#define _RPC_DISPATCH_H
+
+#include <nc_client.h>
+
+/**
+ * \brief Dispatcher of the RPCs of a NETCONF session.
+ *
+ * Its thread sends the RPCs as they are submitted, without waiting for the
+ * replies of the previous ones, and receives the replies. Servers process the
+ * RPCs of a session in order, so the replies are matched by message-id to
+ * the oldest RPC sent. Several requests can thus use a session at once, a
+ * long operation does not delay sending quick ones.
+ *
+ * Threading contract:
+ * - rpc_dispatcher_call() can be called by any number of threads at once, it
+ *   needs neither session_lock nor the mutex of the session.
+ * - While the dispatcher runs, the session is read and written only by its
+ *   thread, which also parses the replies into the libyang context of the
+ *   session. Nobody else may send or receive on the session, or do anything
+ *   using its SSH connection or context (nc_connect_ssh_channel() opens
+ *   a channel and loads schemas into the shared context), unless the
+ *   dispatcher is paused by rpc_dispatcher_pause().
+ * - A thread holding a pause must not call rpc_dispatcher_call() on the same
+ *   dispatcher, the call would wait for the resume forever.
+ * - The notification thread of libnetconf (nc_recv_notif_dispatch()) shares
+ *   the session with the dispatcher, libnetconf serializes their reads itself.
+ */
+struct rpc_dispatcher;
+
+/**
+ * \brief Start a dispatcher of a session
+ * \param[in] session NETCONF session, it must not be read by anyone else
+ * \return New dispatcher, NULL on error.
+ */
+struct rpc_dispatcher *rpc_dispatcher_new(struct nc_session *session);
+
+/**
+ * \brief Send an RPC and wait for its reply
+ *
+ * Errors reported by libnetconf while sending and receiving are passed to the
+ * error reply of the calling thread.
+ *
+ * \param[in] dispatcher dispatcher of the session
+ * \param[in] rpc RPC to send, it must stay valid until the function returns
+ * \param[in] timeout timeout of the whole call in milliseconds
+ * \param[in] strict whether to parse the reply strictly
+ * \param[out] reply received reply
+ * \return NC_MSG_REPLY on success, NC_MSG_WOULDBLOCK on timeout, the result of libnetconf on error.
+ */
+NC_MSG_TYPE rpc_dispatcher_call(struct rpc_dispatcher *dispatcher, struct nc_rpc *rpc, int timeout, int strict,
+                                struct nc_reply **reply);
+
+/**
+ * \brief Get exclusive use of the session of a dispatcher
+ *
+ * No more RPCs are sent, the function waits for the replies of those already
+ * sent (or for their timeouts) and until the thread leaves the session. RPCs
+ * submitted meanwhile wait in the queue until rpc_dispatcher_resume().
+ * Pauses can be nested.
+ *
+ * \param[in] dispatcher dispatcher of the session
+ */
+void rpc_dispatcher_pause(struct rpc_dispatcher *dispatcher);
+
+/**
+ * \brief Release the session got by rpc_dispatcher_pause(), the queued RPCs are sent
+ */
+void rpc_dispatcher_resume(struct rpc_dispatcher *dispatcher);
+
+/**
+ * \brief Stop a dispatcher, the RPCs in progress and the later ones fail
+ */
+void rpc_dispatcher_stop(struct rpc_dispatcher *dispatcher);
+
+/**
+ * \brief Stop and free a dispatcher, the session is not freed
+ */
+void rpc_dispatcher_free(struct rpc_dispatcher *dispatcher);
+
+#endif
@@ -0,0 +1,310 @@
+/*!
+ * \file session_table.c
+ * \brief Index of the NETCONF sessions
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <nc_client.h>
+
+#include "netopeerguid.h"
+#include "session_table.h"
+
+#define SESSION_TABLE_MIN_SIZE 64
+#define SESSION_USER_MIN_SIZE 16
+
+/* keys and session-ids are mostly assigned sequentially, their low bits spread well */
+#define SESSION_TABLE_BUCKET(key, size) ((key) & ((size) - 1))
+
+/**
+ * \brief Double the number of buckets of both the indexes.
+ */
+static int
+session_table_grow(struct session_table *table)
+{
+    struct session_with_mutex **by_key, **by_sid, *session, *next;
+    unsigned int i, size;
+
+    size = table->size ? 2 * table->size : SESSION_TABLE_MIN_SIZE;
+    by_key = calloc(size, sizeof *by_key);
+    by_sid = calloc(size, sizeof *by_sid);
+    if (!by_key || !by_sid) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        free(by_key);
+        free(by_sid);
+        return 1;
+    }
+
+    for (i = 0; i < table->size; ++i) {
+        for (session = table->by_key[i]; session; session = next) {
+            next = session->key_next;
+            session->key_next = by_key[SESSION_TABLE_BUCKET(session->session_key, size)];
+            by_key[SESSION_TABLE_BUCKET(session->session_key, size)] = session;
+        }
+        for (session = table->by_sid[i]; session; session = next) {
+            next = session->sid_next;
+            session->sid_next = by_sid[SESSION_TABLE_BUCKET(session->sid, size)];
+            by_sid[SESSION_TABLE_BUCKET(session->sid, size)] = session;
+        }
+    }
+
+    free(table->by_key);
+    free(table->by_sid);
+    table->by_key = by_key;
+    table->by_sid = by_sid;
+    table->size = size;
+    return 0;
+}
+
+/**
+ * \brief FNV-1a hash of a username.
+ */
+static uint32_t
+session_user_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    for (; *name; ++name) {
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * \brief Double the number of buckets of the users.
+ */
+static int
+session_user_grow(struct session_table *table)
+{
+    struct session_user **users, *user, *next;
+    unsigned int i, size, bucket;
+
+    size = table->user_size ? 2 * table->user_size : SESSION_USER_MIN_SIZE;
+    users = calloc(size, sizeof *users);
+    if (!users) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        return 1;
+    }
+
+    for (i = 0; i < table->user_size; ++i) {
+        for (user = table->users[i]; user; user = next) {
+            next = user->next;
+            bucket = SESSION_TABLE_BUCKET(session_user_hash(user->name), size);
+            user->next = users[bucket];
+            users[bucket] = user;
+        }
+    }
+
+    free(table->users);
+    table->users = users;
+    table->user_size = size;
+    return 0;
+}
+
+/**
+ * \brief Get the user of a new session, it is created with the first session.
+ */
+static struct session_user *
+session_user_get(struct session_table *table, const char *name)
+{
+    struct session_user *user = NULL;
+    unsigned int bucket;
+
+    if (table->user_size) {
+        for (user = table->users[SESSION_TABLE_BUCKET(session_user_hash(name), table->user_size)];
+             user && strcmp(user->name, name);
+             user = user->next);
+    }
+    if (user) {
+        ++user->sessions;
+        return user;
+    }
+
+    if ((table->user_count == table->user_size) && session_user_grow(table)) {
+        return NULL;
+    }
+    if (!(user = calloc(1, sizeof *user)) || !(user->name = strdup(name))) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        free(user);
+        return NULL;
+    }
+    user->last_activity = time(NULL);
+    user->sessions = 1;
+
+    bucket = SESSION_TABLE_BUCKET(session_user_hash(name), table->user_size);
+    user->next = table->users[bucket];
+    table->users[bucket] = user;
+    ++table->user_count;
+    return user;
+}
+
+/**
+ * \brief Detach a session from its user, the user is freed with its last session.
+ */
+static void
+session_user_put(struct session_table *table, struct session_user *user)
+{
+    struct session_user **iter;
+
+    if (--user->sessions) {
+        return;
+    }
+
+    for (iter = &table->users[SESSION_TABLE_BUCKET(session_user_hash(user->name), table->user_size)];
+         *iter != user;
+         iter = &(*iter)->next);
+    *iter = user->next;
+    --table->user_count;
+
+    free(user->name);
+    free(user);
+}
+
+void
+session_table_clean(struct session_table *table)
+{
+    struct session_user *user, *next;
+    unsigned int i;
+
+    for (i = 0; i < table->user_size; ++i) {
+        for (user = table->users[i]; user; user = next) {
+            next = user->next;
+            free(user->name);
+            free(user);
+        }
+    }
+    free(table->users);
+    free(table->by_key);
+    free(table->by_sid);
+    table->users = NULL;
+    table->by_key = NULL;
+    table->by_sid = NULL;
+    table->user_size = 0;
+    table->user_count = 0;
+    table->size = 0;
+    table->count = 0;
+}
+
+int
+session_table_add(struct session_table *table, struct session_with_mutex *session, const char *username)
+{
+    struct session_user *user;
+    unsigned int i;
+
+    if (!(user = session_user_get(table, username))) {
+        return 1;
+    }
+    if ((table->count == table->size) && session_table_grow(table)) {
+        session_user_put(table, user);
+        return 1;
+    }
+    session->user = user;
+
+    i = SESSION_TABLE_BUCKET(session->session_key, table->size);
+    session->key_next = table->by_key[i];
+    table->by_key[i] = session;
+
+    i = SESSION_TABLE_BUCKET(session->sid, table->size);
+    session->sid_next = table->by_sid[i];
+    table->by_sid[i] = session;
+
+    ++table->count;
+    return 0;
+}
+
+void
+session_table_remove(struct session_table *table, struct session_with_mutex *session)
+{
+    struct session_with_mutex **iter;
+
+    if (!table->size) {
+        return;
+    }
+
+    for (iter = &table->by_key[SESSION_TABLE_BUCKET(session->session_key, table->size)];
+         *iter && (*iter != session);
+         iter = &(*iter)->key_next);
+    if (!*iter) {
+        /* not indexed */
+        return;
+    }
+    *iter = session->key_next;
+    session->key_next = NULL;
+
+    for (iter = &table->by_sid[SESSION_TABLE_BUCKET(session->sid, table->size)];
+         *iter && (*iter != session);
+         iter = &(*iter)->sid_next);
+    if (*iter) {
+        *iter = session->sid_next;
+    }
+    session->sid_next = NULL;
+
+    session_user_put(table, session->user);
+    session->user = NULL;
+    --table->count;
+}
+
+struct session_with_mutex *
+session_table_find(const struct session_table *table, unsigned int session_key)
+{
+    struct session_with_mutex *session;
+
+    if (!table->size) {
+        return NULL;
+    }
+    for (session = table->by_key[SESSION_TABLE_BUCKET(session_key, table->size)];
+         session && (session->session_key != session_key);
+         session = session->key_next);
+    return session;
+}
+
+struct session_with_mutex *
+session_table_find_sid(const struct session_table *table, uint32_t sid)
+{
+    struct session_with_mutex *session;
+
+    if (!table->size) {
+        return NULL;
+    }
+    for (session = table->by_sid[SESSION_TABLE_BUCKET(sid, table->size)];
+         session && (session->sid != sid);
+         session = session->sid_next);
+    return session;
+}
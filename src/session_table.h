@@ -0,0 +1,112 @@
+/*!
+ * \file session_table.h
+ * \brief Index of the NETCONF sessions
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#ifndef _SESSION_TABLE_H
+#define _SESSION_TABLE_H
+
+#include <stdint.h>
+#include <time.h>
+
+struct session_with_mutex;
+
+/**
+ * \brief User of the sessions, the activity of any of them keeps all of them open.
+ */
+struct session_user {
+    char *name;                     /**< username */
+    time_t last_activity;           /**< time of the last request of the user */
+    unsigned int sessions;          /**< number of sessions of the user */
+    struct session_user *next;      /**< next user in the same bucket */
+};
+
+/**
+ * \brief Hash index of the sessions by their key and by their NETCONF session-id, and of their users.
+ *
+ * The sessions are chained in the buckets through their own members, the
+ * index allocates only the buckets and the users. It is protected by
+ * session_lock, lookups need the read lock, changes the write lock.
+ */
+struct session_table {
+    struct session_with_mutex **by_key;     /**< buckets chained by key_next */
+    struct session_with_mutex **by_sid;     /**< buckets chained by sid_next */
+    unsigned int size;                      /**< number of buckets of each index, a power of 2 */
+    unsigned int count;                     /**< number of sessions */
+    struct session_user **users;            /**< buckets of the users */
+    unsigned int user_size;                 /**< number of buckets of the users, a power of 2 */
+    unsigned int user_count;                /**< number of users */
+};
+
+/**
+ * \brief Free the buckets and the users of an index, the sessions are not freed
+ */
+void session_table_clean(struct session_table *table);
+
+/**
+ * \brief Add a session with a unique key and attach it to its user
+ * \param[in] table index
+ * \param[in] session session to add
+ * \param[in] username user of the session
+ * \return 0 on success, 1 on memory allocation failure.
+ */
+int session_table_add(struct session_table *table, struct session_with_mutex *session, const char *username);
+
+/**
+ * \brief Remove a session, it is not freed, its user is freed with the last session of the user
+ */
+void session_table_remove(struct session_table *table, struct session_with_mutex *session);
+
+/**
+ * \brief Find a session by its key
+ * \return Session, NULL if there is none.
+ */
+struct session_with_mutex *session_table_find(const struct session_table *table, unsigned int session_key);
+
+/**
+ * \brief Find a session by its NETCONF session-id
+ *
+ * Sessions to different servers may have the same session-id, the most recent
+ * one is returned then.
+ *
+ * \return Session, NULL if there is none.
+ */
+struct session_with_mutex *session_table_find_sid(const struct session_table *table, uint32_t sid);
+
+#endif
@@ -0,0 +1,125 @@
+/*!
+ * \file session_timer.c
+ * \brief Expiration of idle NETCONF sessions
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#define _GNU_SOURCE
+#include <string.h>
+#include <nc_client.h>
+
+#include "netopeerguid.h"
+#include "session_table.h"
+#include "session_timer.h"
+
+#define SESSION_TIMER_SLOT(tick) ((unsigned int)(tick) & (SESSION_TIMER_SLOTS - 1))
+
+void
+session_timer_init(struct session_timer *timer, unsigned int timeout, unsigned int resolution, time_t now)
+{
+    memset(timer, 0, sizeof *timer);
+    timer->timeout = timeout;
+    timer->resolution = resolution ? resolution : 1;
+    timer->tick = now / timer->resolution;
+}
+
+void
+session_timer_add(struct session_timer *timer, struct session_with_mutex *session)
+{
+    unsigned int slot;
+
+    /* the first tick after the deadline */
+    slot = SESSION_TIMER_SLOT((session->user->last_activity + timer->timeout) / timer->resolution + 1);
+    session->timer_slot = slot;
+    session->timer_prev = NULL;
+    session->timer_next = timer->slots[slot];
+    if (session->timer_next) {
+        session->timer_next->timer_prev = session;
+    }
+    timer->slots[slot] = session;
+}
+
+void
+session_timer_remove(struct session_timer *timer, struct session_with_mutex *session)
+{
+    if (session->timer_prev) {
+        session->timer_prev->timer_next = session->timer_next;
+    } else if (timer->slots[session->timer_slot] == session) {
+        timer->slots[session->timer_slot] = session->timer_next;
+    } else {
+        /* not scheduled */
+        return;
+    }
+    if (session->timer_next) {
+        session->timer_next->timer_prev = session->timer_prev;
+    }
+    session->timer_prev = session->timer_next = NULL;
+}
+
+struct session_with_mutex *
+session_timer_expire(struct session_timer *timer, time_t now)
+{
+    struct session_with_mutex *session, *next, *expired = NULL;
+    time_t last = now / timer->resolution;
+    unsigned int slot;
+
+    if (last - timer->tick >= SESSION_TIMER_SLOTS) {
+        /* all the slots are due, every one is processed once */
+        timer->tick = last - SESSION_TIMER_SLOTS + 1;
+    }
+
+    for (; timer->tick <= last; ++timer->tick) {
+        slot = SESSION_TIMER_SLOT(timer->tick);
+        session = timer->slots[slot];
+        timer->slots[slot] = NULL;
+
+        for (; session; session = next) {
+            next = session->timer_next;
+            if (now - session->user->last_activity > timer->timeout) {
+                session->timer_prev = NULL;
+                session->timer_next = expired;
+                expired = session;
+            } else {
+                /* active meanwhile, its deadline is in a later tick */
+                session_timer_add(timer, session);
+            }
+        }
+    }
+
+    return expired;
+}
@@ -0,0 +1,97 @@
+/*!
+ * \file session_timer.h
+ * \brief Expiration of idle NETCONF sessions
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#ifndef _SESSION_TIMER_H
+#define _SESSION_TIMER_H
+
+#include <time.h>
+
+/**
+ * \brief Number of slots of the timer wheel, a power of 2
+ */
+#define SESSION_TIMER_SLOTS 512
+
+struct session_with_mutex;
+
+/**
+ * \brief Timer wheel of the idle sessions.
+ *
+ * Every session is put in the slot of the tick following its deadline, the
+ * last activity of its user plus the timeout. Activity only updates the time
+ * in the user, the session is moved to a later slot when its old slot is due, so both the
+ * activity and the expiration cost O(1) per session. It is protected by
+ * session_lock, changes need the write lock.
+ */
+struct session_timer {
+    struct session_with_mutex *slots[SESSION_TIMER_SLOTS]; /**< sessions chained by timer_next */
+    unsigned int timeout;       /**< idle time after which a session expires, in seconds */
+    unsigned int resolution;    /**< length of a tick, in seconds */
+    time_t tick;                /**< the next tick to process */
+};
+
+/**
+ * \brief Initialize an empty timer wheel
+ * \param[in] timer timer wheel
+ * \param[in] timeout idle time after which a session expires, in seconds
+ * \param[in] resolution length of a tick, in seconds, the sessions expire at most this late
+ * \param[in] now current time
+ */
+void session_timer_init(struct session_timer *timer, unsigned int timeout, unsigned int resolution, time_t now);
+
+/**
+ * \brief Schedule the expiration of a session according to the last activity of its user
+ */
+void session_timer_add(struct session_timer *timer, struct session_with_mutex *session);
+
+/**
+ * \brief Cancel the expiration of a session
+ */
+void session_timer_remove(struct session_timer *timer, struct session_with_mutex *session);
+
+/**
+ * \brief Process the ticks due and remove the expired sessions from the wheel
+ * \param[in] timer timer wheel
+ * \param[in] now current time
+ * \return Expired sessions chained by timer_next, NULL if there are none.
+ */
+struct session_with_mutex *session_timer_expire(struct session_timer *timer, time_t now);
+
+#endif
@@ -0,0 +1,240 @@
+/*!
+ * \file single_flight.c
+ * \brief Coalescing of identical requests of a session
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <nc_client.h>
+
+#include "netopeerguid.h"
+#include "single_flight.h"
+
+struct flight_group {
+    pthread_mutex_t lock;           /**< protects the flights and their references */
+    pthread_cond_t cond;            /**< signalled when a flight lands */
+    struct flight *flights;         /**< flights in progress */
+};
+
+static void
+flight_free(struct flight *flight)
+{
+    if (flight->owner_free) {
+        flight->owner_free(flight->owner);
+    }
+    if (flight->err) {
+        json_object_put(flight->err);
+    }
+    free(flight->filter);
+    free(flight);
+}
+
+static int
+flight_match(struct flight *flight, enum flight_op op, NC_DATASTORE source, const char *filter, int strict)
+{
+    if ((flight->op != op) || (flight->strict != strict) || ((op == FLIGHT_GETCONFIG) && (flight->source != source))) {
+        return 0;
+    }
+    if (!flight->filter || !filter) {
+        return flight->filter == filter;
+    }
+    return !strcmp(flight->filter, filter);
+}
+
+struct flight_group *
+flight_group_new(void)
+{
+    struct flight_group *group;
+
+    group = calloc(1, sizeof *group);
+    if (!group) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        return NULL;
+    }
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->cond, NULL);
+    return group;
+}
+
+void
+flight_group_free(struct flight_group *group)
+{
+    if (!group) {
+        return;
+    }
+    pthread_cond_destroy(&group->cond);
+    pthread_mutex_destroy(&group->lock);
+    free(group);
+}
+
+struct flight *
+flight_join(struct flight_group *group, enum flight_op op, NC_DATASTORE source, const char *filter, int strict,
+            int *leader)
+{
+    struct flight *flight;
+
+    if (group) {
+        pthread_mutex_lock(&group->lock);
+        for (flight = group->flights; flight; flight = flight->next) {
+            if (flight_match(flight, op, source, filter, strict)) {
+                ++flight->refcount;
+                pthread_mutex_unlock(&group->lock);
+                *leader = 0;
+                return flight;
+            }
+        }
+    }
+
+    flight = calloc(1, sizeof *flight);
+    if (!flight || (filter && !(flight->filter = strdup(filter)))) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        free(flight);
+        if (group) {
+            pthread_mutex_unlock(&group->lock);
+        }
+        return NULL;
+    }
+    flight->op = op;
+    flight->source = source;
+    flight->strict = strict;
+    flight->refcount = 1;
+    if (group) {
+        flight->group = group;
+        flight->next = group->flights;
+        group->flights = flight;
+        pthread_mutex_unlock(&group->lock);
+    }
+
+    *leader = 1;
+    return flight;
+}
+
+void
+flight_land(struct flight *flight, const struct lyd_node *data, const char *version, void *owner,
+            void (*owner_free)(void *owner), json_object *err)
+{
+    struct flight_group *group = flight->group;
+    struct flight **iter;
+    json_object *err_copy = NULL;
+
+    if (!group) {
+        flight->data = data;
+        flight->version = version;
+        flight->owner = owner;
+        flight->owner_free = owner_free;
+        flight->landed = 1;
+        return;
+    }
+
+    /* the reply of the leader is its own, the joined requests get a copy */
+    if (!data && err) {
+        json_object_deep_copy(err, &err_copy, NULL);
+    }
+
+    pthread_mutex_lock(&group->lock);
+    for (iter = &group->flights; *iter != flight; iter = &(*iter)->next);
+    *iter = flight->next;
+    flight->next = NULL;
+
+    flight->data = data;
+    flight->version = version;
+    flight->owner = owner;
+    flight->owner_free = owner_free;
+    flight->err = err_copy;
+    flight->landed = 1;
+    pthread_cond_broadcast(&group->cond);
+    pthread_mutex_unlock(&group->lock);
+}
+
+void
+flight_wait(struct flight *flight)
+{
+    struct flight_group *group = flight->group;
+
+    if (!group) {
+        return;
+    }
+
+    pthread_mutex_lock(&group->lock);
+    while (!flight->landed) {
+        pthread_cond_wait(&group->cond, &group->lock);
+    }
+    pthread_mutex_unlock(&group->lock);
+}
+
+json_object *
+flight_error(struct flight *flight)
+{
+    json_object *reply = NULL;
+
+    if (flight->group) {
+        pthread_mutex_lock(&flight->group->lock);
+    }
+    if (flight->err) {
+        json_object_deep_copy(flight->err, &reply, NULL);
+    }
+    if (flight->group) {
+        pthread_mutex_unlock(&flight->group->lock);
+    }
+
+    if (!reply) {
+        reply = create_error_reply("Operation failed.");
+    }
+    return reply;
+}
+
+void
+flight_leave(struct flight *flight)
+{
+    int last;
+
+    if (flight->group) {
+        pthread_mutex_lock(&flight->group->lock);
+        last = !--flight->refcount;
+        pthread_mutex_unlock(&flight->group->lock);
+    } else {
+        last = !--flight->refcount;
+    }
+
+    if (last) {
+        flight_free(flight);
+    }
+}
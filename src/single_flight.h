@@ -0,0 +1,143 @@
+/*!
+ * \file single_flight.h
+ * \brief Coalescing of identical requests of a session
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#ifndef _SINGLE_FLIGHT_H
+#define _SINGLE_FLIGHT_H
+
+#include <pthread.h>
+#include <json.h>
+#include <libyang/libyang.h>
+#include <nc_client.h>
+
+/**
+ * \brief Operations that can be coalesced
+ */
+enum flight_op {
+    FLIGHT_GET,
+    FLIGHT_GETCONFIG
+};
+
+/**
+ * \brief Retrieval of data from the server shared by identical requests.
+ *
+ * The first request (the leader) performs the operation and lands the flight
+ * with its result, the requests joining it meanwhile wait for the result and
+ * use it too. The result stays valid until the last participant leaves.
+ */
+struct flight {
+    enum flight_op op;              /**< operation */
+    NC_DATASTORE source;            /**< datastore of get-config */
+    char *filter;                   /**< subtree filter, NULL for none */
+    int strict;                     /**< whether the data are parsed strictly */
+
+    int landed;                     /**< the result is available */
+    const struct lyd_node *data;    /**< received data, NULL on error, read-only */
+    const char *version;            /**< version of the data, can be NULL */
+    void *owner;                    /**< object holding the data, freed with the flight */
+    void (*owner_free)(void *owner);
+    json_object *err;               /**< error reply for the joined requests */
+
+    unsigned int refcount;          /**< protected by the lock of the group */
+    struct flight_group *group;     /**< NULL if the flight is not shared */
+    struct flight *next;
+};
+
+/**
+ * \brief Flights of a session
+ */
+struct flight_group;
+
+/**
+ * \brief Create a group without flights
+ * \return New group, NULL on memory allocation failure.
+ */
+struct flight_group *flight_group_new(void);
+
+/**
+ * \brief Free a group, none of its flights may be in progress
+ */
+void flight_group_free(struct flight_group *group);
+
+/**
+ * \brief Join a flight in progress or start a new one
+ * \param[in] group flights of the session, NULL not to share the flight
+ * \param[in] op operation
+ * \param[in] source datastore of get-config
+ * \param[in] filter subtree filter, can be NULL
+ * \param[in] strict whether the data are parsed strictly
+ * \param[out] leader whether the caller started the flight and must land it
+ * \return Referenced flight, NULL on memory allocation failure.
+ */
+struct flight *flight_join(struct flight_group *group, enum flight_op op, NC_DATASTORE source, const char *filter,
+                           int strict, int *leader);
+
+/**
+ * \brief Land a flight with its result, called once by the leader
+ *
+ * Later requests do not join the flight anymore.
+ *
+ * \param[in] flight flight
+ * \param[in] data received data, NULL on error
+ * \param[in] version version of the data, can be NULL
+ * \param[in] owner object holding the data, taken over
+ * \param[in] owner_free function freeing the owner
+ * \param[in] err error reply of the leader, it is copied for the joined requests
+ */
+void flight_land(struct flight *flight, const struct lyd_node *data, const char *version, void *owner,
+                 void (*owner_free)(void *owner), json_object *err);
+
+/**
+ * \brief Wait for the leader to land a flight
+ */
+void flight_wait(struct flight *flight);
+
+/**
+ * \brief Get the error reply of a landed flight without data
+ * \return New error reply.
+ */
+json_object *flight_error(struct flight *flight);
+
+/**
+ * \brief Release a reference of a flight
+ */
+void flight_leave(struct flight *flight);
+
+#endif
@@ -0,0 +1,203 @@
+/*!
+ * \file snapshot.c
+ * \brief Data snapshots retained for delta replies
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <nc_client.h>
+
+#include "netopeerguid.h"
+#include "snapshot.h"
+
+/** \brief Maximum number of snapshots of a session, the oldest ones are dropped */
+#define SNAPSHOT_MAX 8
+
+struct snapshot_store {
+    pthread_mutex_t lock;           /**< protects the members below and the references of the snapshots */
+    struct snapshot *snapshots;     /**< the newest first */
+    unsigned int count;             /**< number of snapshots */
+    uint64_t serial;                /**< number of the last snapshot taken */
+};
+
+static void
+snapshot_free(struct snapshot *snapshot)
+{
+    lyd_free_withsiblings(snapshot->data);
+    free(snapshot->filter);
+    free(snapshot);
+}
+
+/**
+ * \brief Unlink a snapshot from the store, the lock must be held.
+ * \return Whether the snapshot is to be freed.
+ */
+static int
+snapshot_unlink(struct snapshot_store *store, struct snapshot *snapshot)
+{
+    struct snapshot **iter;
+
+    for (iter = &store->snapshots; *iter && (*iter != snapshot); iter = &(*iter)->next);
+    if (!*iter) {
+        /* dropped already */
+        return 0;
+    }
+    *iter = snapshot->next;
+    snapshot->next = NULL;
+    --store->count;
+    return !--snapshot->refcount;
+}
+
+struct snapshot_store *
+snapshot_store_new(void)
+{
+    struct snapshot_store *store;
+
+    store = calloc(1, sizeof *store);
+    if (!store) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        return NULL;
+    }
+    pthread_mutex_init(&store->lock, NULL);
+    return store;
+}
+
+void
+snapshot_store_free(struct snapshot_store *store)
+{
+    struct snapshot *snapshot;
+
+    if (!store) {
+        return;
+    }
+    while ((snapshot = store->snapshots)) {
+        store->snapshots = snapshot->next;
+        snapshot_free(snapshot);
+    }
+    pthread_mutex_destroy(&store->lock);
+    free(store);
+}
+
+struct snapshot *
+snapshot_get(struct snapshot_store *store, const char *token, int operation, NC_DATASTORE source, const char *filter)
+{
+    struct snapshot *snapshot;
+
+    pthread_mutex_lock(&store->lock);
+    for (snapshot = store->snapshots; snapshot && strcmp(snapshot->token, token); snapshot = snapshot->next);
+    if (snapshot) {
+        if ((snapshot->operation != operation) || (snapshot->source != source)
+                || (!snapshot->filter != !filter) || (filter && strcmp(snapshot->filter, filter))) {
+            /* data of another request, the changes would make no sense */
+            snapshot = NULL;
+        } else {
+            ++snapshot->refcount;
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    return snapshot;
+}
+
+int
+snapshot_add(struct snapshot_store *store, int operation, NC_DATASTORE source, const char *filter,
+             const struct lyd_node *data, struct snapshot *replaced, char *token)
+{
+    struct snapshot *snapshot, *oldest, *unused[2] = {NULL, NULL};
+
+    snapshot = calloc(1, sizeof *snapshot);
+    if (!snapshot || (filter && !(snapshot->filter = strdup(filter)))) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        free(snapshot);
+        return 1;
+    }
+    if (data && !(snapshot->data = lyd_dup_withsiblings((struct lyd_node *)data, LYD_DUP_OPT_RECURSIVE))) {
+        ERROR("Copying data for a snapshot failed.");
+        free(snapshot->filter);
+        free(snapshot);
+        return 1;
+    }
+    snapshot->operation = operation;
+    snapshot->source = source;
+    snapshot->refcount = 1;
+    snapshot->store = store;
+
+    pthread_mutex_lock(&store->lock);
+    sprintf(snapshot->token, "%" PRIu64, ++store->serial);
+    if (replaced && snapshot_unlink(store, replaced)) {
+        unused[0] = replaced;
+    }
+    if (store->count == SNAPSHOT_MAX) {
+        for (oldest = store->snapshots; oldest->next; oldest = oldest->next);
+        if (snapshot_unlink(store, oldest)) {
+            unused[1] = oldest;
+        }
+    }
+    snapshot->next = store->snapshots;
+    store->snapshots = snapshot;
+    ++store->count;
+    strcpy(token, snapshot->token);
+    pthread_mutex_unlock(&store->lock);
+
+    if (unused[0]) {
+        snapshot_free(unused[0]);
+    }
+    if (unused[1]) {
+        snapshot_free(unused[1]);
+    }
+    return 0;
+}
+
+void
+snapshot_put(struct snapshot *snapshot)
+{
+    int last;
+
+    pthread_mutex_lock(&snapshot->store->lock);
+    last = !--snapshot->refcount;
+    pthread_mutex_unlock(&snapshot->store->lock);
+
+    if (last) {
+        snapshot_free(snapshot);
+    }
+}
@@ -0,0 +1,115 @@
+/*!
+ * \file snapshot.h
+ * \brief Data snapshots retained for delta replies
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+#include <libyang/libyang.h>
+#include <nc_client.h>
+
+/** \brief Size of a snapshot token including the terminating zero */
+#define SNAPSHOT_TOKEN_SIZE 24
+
+/**
+ * \brief Copy of the data sent to a frontend.
+ *
+ * A later request of the frontend presenting the token gets only the changes
+ * of the data since the snapshot.
+ */
+struct snapshot {
+    char token[SNAPSHOT_TOKEN_SIZE]; /**< identifier given to the frontend */
+    int operation;                  /**< operation the data were retrieved by */
+    NC_DATASTORE source;            /**< datastore of get-config */
+    char *filter;                   /**< subtree filter, NULL for none */
+    struct lyd_node *data;          /**< copy of the data, read-only */
+    unsigned int refcount;          /**< protected by the lock of the store */
+    struct snapshot_store *store;
+    struct snapshot *next;
+};
+
+/**
+ * \brief Snapshots of a session, only a few recent ones are kept.
+ */
+struct snapshot_store;
+
+/**
+ * \brief Create an empty store
+ * \return New store, NULL on memory allocation failure.
+ */
+struct snapshot_store *snapshot_store_new(void);
+
+/**
+ * \brief Free a store, neither it nor any of its snapshots may be used anymore
+ */
+void snapshot_store_free(struct snapshot_store *store);
+
+/**
+ * \brief Find a snapshot of the data of the same request
+ * \param[in] store store
+ * \param[in] token token of the snapshot
+ * \param[in] operation operation of the request
+ * \param[in] source datastore of get-config
+ * \param[in] filter subtree filter, can be NULL
+ * \return Referenced snapshot, NULL if there is none (e.g. it was dropped).
+ */
+struct snapshot *snapshot_get(struct snapshot_store *store, const char *token, int operation, NC_DATASTORE source,
+                              const char *filter);
+
+/**
+ * \brief Take a snapshot of data
+ * \param[in] store store
+ * \param[in] operation operation of the request
+ * \param[in] source datastore of get-config
+ * \param[in] filter subtree filter, can be NULL
+ * \param[in] data data to copy
+ * \param[in] replaced snapshot superseded by the new one and dropped from the store, can be NULL
+ * \param[out] token token of the new snapshot
+ * \return 0 on success, 1 on error.
+ */
+int snapshot_add(struct snapshot_store *store, int operation, NC_DATASTORE source, const char *filter,
+                 const struct lyd_node *data, struct snapshot *replaced, char *token);
+
+/**
+ * \brief Release a reference of a snapshot
+ */
+void snapshot_put(struct snapshot *snapshot);
+
+#endif
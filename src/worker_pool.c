@@ -0,0 +1,230 @@
+/*!
+ * \file worker_pool.c
+ * \brief Fixed-size pool of worker threads fed from a job queue
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <nc_client.h>
+
+#include "netopeerguid.h"
+#include "worker_pool.h"
+
+struct worker_job {
+    worker_job_f func;
+    void *arg;
+    struct worker_job *next;
+};
+
+struct worker_pool {
+    pthread_mutex_t lock;        /**< protects all the members below */
+    pthread_cond_t cond;         /**< signalled when a job is queued or the pool is stopped */
+    struct worker_job *head;     /**< the oldest queued job */
+    struct worker_job *tail;     /**< the newest queued job */
+    int stop;                    /**< set when the pool is being destroyed */
+    struct worker_pool_stats stats;
+    void (*thread_init)(void);
+    void (*thread_clean)(void);
+    pthread_t *tids;
+    unsigned int tid_count;      /**< number of successfully started workers */
+};
+
+static void *
+worker_routine(void *arg)
+{
+    struct worker_pool *pool = (struct worker_pool *)arg;
+    struct worker_job *job;
+
+    if (pool->thread_init) {
+        pool->thread_init();
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->head && !pool->stop) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        if (!pool->head) {
+            /* stopped and nothing left to do */
+            break;
+        }
+
+        job = pool->head;
+        pool->head = job->next;
+        if (!pool->head) {
+            pool->tail = NULL;
+        }
+        --pool->stats.queued;
+        ++pool->stats.busy;
+        pthread_mutex_unlock(&pool->lock);
+
+        job->func(job->arg);
+        free(job);
+
+        pthread_mutex_lock(&pool->lock);
+        --pool->stats.busy;
+        ++pool->stats.done;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (pool->thread_clean) {
+        pool->thread_clean();
+    }
+    return NULL;
+}
+
+struct worker_pool *
+worker_pool_create(unsigned int workers, void (*thread_init)(void), void (*thread_clean)(void))
+{
+    struct worker_pool *pool;
+    unsigned int i;
+    int ret;
+
+    pool = calloc(1, sizeof *pool);
+    if (!pool) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        return NULL;
+    }
+    pool->tids = calloc(workers, sizeof *pool->tids);
+    if (!pool->tids) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    pool->thread_init = thread_init;
+    pool->thread_clean = thread_clean;
+
+    for (i = 0; i < workers; ++i) {
+        if ((ret = pthread_create(&pool->tids[i], NULL, worker_routine, pool)) != 0) {
+            ERROR("Creating POSIX thread failed: %d", ret);
+            break;
+        }
+        DEBUG("Worker thread %lu created", pool->tids[i]);
+    }
+    pool->tid_count = i;
+    pool->stats.workers = i;
+
+    if (!pool->tid_count) {
+        worker_pool_destroy(pool, 0);
+        return NULL;
+    }
+    return pool;
+}
+
+int
+worker_pool_submit(struct worker_pool *pool, worker_job_f job, void *arg)
+{
+    struct worker_job *new_job;
+
+    new_job = malloc(sizeof *new_job);
+    if (!new_job) {
+        ERROR("Memory allocation failed (%s:%d).", __FILE__, __LINE__);
+        return -1;
+    }
+    new_job->func = job;
+    new_job->arg = arg;
+    new_job->next = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->stop) {
+        pthread_mutex_unlock(&pool->lock);
+        free(new_job);
+        return -1;
+    }
+    if (pool->tail) {
+        pool->tail->next = new_job;
+    } else {
+        pool->head = new_job;
+    }
+    pool->tail = new_job;
+    if (++pool->stats.queued > pool->stats.queued_max) {
+        pool->stats.queued_max = pool->stats.queued;
+    }
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+void
+worker_pool_stats(struct worker_pool *pool, struct worker_pool_stats *stats)
+{
+    pthread_mutex_lock(&pool->lock);
+    memcpy(stats, &pool->stats, sizeof *stats);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void
+worker_pool_destroy(struct worker_pool *pool, int timeout)
+{
+    struct timespec maxtime;
+    unsigned int i;
+    int joined = 1;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    clock_gettime(CLOCK_REALTIME, &maxtime);
+    maxtime.tv_sec += timeout;
+    for (i = 0; i < pool->tid_count; ++i) {
+        if (pthread_timedjoin_np(pool->tids[i], NULL, &maxtime)) {
+            joined = 0;
+        }
+    }
+
+    if (!joined) {
+        /* some worker is still stuck in a job, the pool must stay valid for it */
+        ERROR("Some worker threads did not terminate in time.");
+        return;
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+    free(pool->tids);
+    free(pool);
+}
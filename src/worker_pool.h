@@ -0,0 +1,95 @@
+/*!
+ * \file worker_pool.h
+ * \brief Fixed-size pool of worker threads fed from a job queue
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+#ifndef _WORKER_POOL_H
+#define _WORKER_POOL_H
+
+/**
+ * \brief Job executed by a worker thread.
+ */
+typedef void (*worker_job_f)(void *arg);
+
+struct worker_pool;
+
+/**
+ * \brief Runtime counters of a worker pool.
+ */
+struct worker_pool_stats {
+    unsigned int workers;        /**< number of worker threads */
+    unsigned int busy;           /**< workers currently executing a job */
+    unsigned int queued;         /**< jobs waiting in the queue */
+    unsigned int queued_max;     /**< the highest number of waiting jobs seen */
+    unsigned long long done;     /**< number of jobs executed so far */
+};
+
+/**
+ * \brief Start a pool of worker threads
+ * \param[in] workers number of worker threads
+ * \param[in] thread_init function called by every worker when it starts, can be NULL
+ * \param[in] thread_clean function called by every worker before it terminates, can be NULL
+ * \return new pool, NULL on error
+ */
+struct worker_pool *worker_pool_create(unsigned int workers, void (*thread_init)(void), void (*thread_clean)(void));
+
+/**
+ * \brief Queue a job, it is executed by the first idle worker
+ * \param[in] pool worker pool
+ * \param[in] job function to execute
+ * \param[in] arg argument of the job
+ * \return 0 on success, -1 on error (the job will never be executed)
+ */
+int worker_pool_submit(struct worker_pool *pool, worker_job_f job, void *arg);
+
+/**
+ * \brief Get the current counters of the pool
+ * \param[in] pool worker pool
+ * \param[out] stats filled counters
+ */
+void worker_pool_stats(struct worker_pool *pool, struct worker_pool_stats *stats);
+
+/**
+ * \brief Stop the pool - the queued jobs are still executed, then the workers terminate
+ * \param[in] pool worker pool
+ * \param[in] timeout maximal time in seconds to wait for the workers to terminate
+ */
+void worker_pool_destroy(struct worker_pool *pool, int timeout);
+
+#endif